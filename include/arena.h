@@ -0,0 +1,46 @@
+#ifndef FILE_BROWSER_ARENA_H
+#define FILE_BROWSER_ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Bump allocator for many small allocations that are freed together.
+ * Allocations are never moved, and are only freed when the arena is reset or cleared.
+ * An arena must only be used by one thread at a time.
+ */
+typedef struct {
+    /* Chunks of the arena, the current chunk first. */
+    struct FBArenaChunk *chunks;
+    /* Free space of the current chunk. */
+    char *pos;
+    char *end;
+    /* Bytes of all chunks. */
+    size_t size;
+} FBArena;
+
+/**
+ * Initializes an empty arena.
+ */
+void arena_init ( FBArena *arena );
+
+/**
+ * Allocates memory aligned for pointers from the arena.
+ */
+void *arena_alloc ( FBArena *arena, size_t size );
+
+/**
+ * Moves all allocations of src to dst. src is left empty.
+ */
+void arena_merge ( FBArena *dst, FBArena *src );
+
+/**
+ * Frees all allocations of the arena, but keeps its first chunk for reuse.
+ */
+void arena_reset ( FBArena *arena );
+
+/**
+ * Frees all allocations and chunks of the arena.
+ */
+void arena_clear ( FBArena *arena );
+
+#endif
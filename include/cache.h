@@ -0,0 +1,105 @@
+#ifndef FILE_BROWSER_CACHE_H
+#define FILE_BROWSER_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#include "types.h"
+
+/**
+ * Entry type of a cached subdirectory that is descended into, instead of being listed as a file.
+ */
+#define CACHE_DESCEND 0xff
+
+/**
+ * A persistent listing cache for one directory and one set of listing options.
+ * The cache file is memory-mapped and stores one record per read directory: the directory's mtime, ctime and inode,
+ * followed by the files found in it and the subdirectories that were descended into.
+ * A record is only used if the directory's mtime, ctime and inode are unchanged, so only changed directories are
+ * read again.
+ */
+typedef struct FBCache FBCache;
+
+/**
+ * A cached directory, pointing into the memory-mapped cache file.
+ */
+typedef struct FBCacheDir FBCacheDir;
+
+/**
+ * Collects the directory records of one walker thread for the new cache file.
+ */
+typedef struct {
+    FBCache *cache;
+    /* The records collected so far. */
+    GByteArray *data;
+    /* Offset of the record that is currently written, -1 if no record is written. */
+    gssize dir;
+    /* Number of directories that were read / taken from the cache. */
+    unsigned int num_read;
+    unsigned int num_copied;
+} FBCacheRecorder;
+
+/**
+ * Opens the cache file for the current directory and the listing options of the file data.
+ * If there is no valid cache file yet, an empty cache is returned.
+ */
+FBCache *cache_open ( FileBrowserFileData *fd );
+
+/**
+ * Returns the cached record of a directory, or NULL if it is not cached or has changed since it was cached.
+ * rel_path is the path of the directory relative to the current directory ("" for the current directory),
+ * st is the result of stat'ing the directory.
+ * Can be called from multiple threads at once.
+ */
+const FBCacheDir *cache_lookup ( FBCache *cache, const char *rel_path, const struct stat *st );
+
+/**
+ * Iterates over the entries of a cached directory. *pos must be 0 for the first call.
+ * Returns false if there are no more entries. type is a FBFileType or CACHE_DESCEND.
+ */
+bool cache_dir_next ( const FBCacheDir *dir, size_t *pos, const char **name, unsigned char *type );
+
+/**
+ * Initializes a recorder for the given cache.
+ */
+void cache_recorder_init ( FBCacheRecorder *recorder, FBCache *cache );
+
+/**
+ * Starts the record of a directory that is read. Directories that changed during the last second are not recorded,
+ * since further changes in the same second would not change their mtime.
+ */
+void cache_recorder_begin ( FBCacheRecorder *recorder, const char *rel_path, const struct stat *st );
+
+/**
+ * Adds an entry to the current record. type is a FBFileType or CACHE_DESCEND.
+ */
+void cache_recorder_add ( FBCacheRecorder *recorder, const char *name, unsigned char type );
+
+/**
+ * Ends the current record.
+ */
+void cache_recorder_end ( FBCacheRecorder *recorder );
+
+/**
+ * Copies the record of an unchanged directory.
+ */
+void cache_recorder_copy ( FBCacheRecorder *recorder, const FBCacheDir *dir );
+
+/**
+ * Frees the recorded data.
+ */
+void cache_recorder_clear ( FBCacheRecorder *recorder );
+
+/**
+ * Replaces the cache file with the records of the given recorders.
+ * Does nothing if all directories were taken from the cache and the cache file has no other records.
+ */
+void cache_save ( FBCache *cache, FBCacheRecorder *recorders, unsigned int num_recorders );
+
+/**
+ * Unmaps the cache file and frees the cache.
+ */
+void cache_close ( FBCache *cache );
+
+#endif
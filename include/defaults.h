@@ -13,6 +13,33 @@
 /* The depth up to which files are recursively listed. */
 #define DEPTH 1
 
+/* The number of threads used to list files recursively. 0 means one thread per processor. */
+#define THREADS 1
+
+/* List files in the background and show them while they are listed. */
+#define STREAM false
+
+/* The depth up to which files on network and FUSE mounts (NFS, SMB, sshfs, ...) are listed. 0 means no limit. */
+#define SLOW_FS_DEPTH 0
+
+/* Skip files matched by .gitignore, .ignore and .git/info/exclude files. */
+#define USE_IGNORE_FILES false
+
+/* Keep recursive listings in a persistent cache. */
+#define USE_CACHE false
+
+/* The directory of the listing cache files. */
+#define CACHE_DIR g_build_filename ( g_get_user_cache_dir (), "rofi", "file-browser", NULL )
+
+/* Memory budget for recently visited listings in MiB. 0 disables keeping them. */
+#define LRU_MEMORY 16
+
+/* Update the file list when files are created or deleted. */
+#define WATCH false
+
+/* Maximum number of directories watched for changes. */
+#define WATCH_LIMIT 1024
+
 /* Only show directories. */
 #define ONLY_DIRS false
 
@@ -25,6 +52,15 @@
 /* Show hidden files by default. */
 #define SHOW_HIDDEN false
 
+/* Maximum number of hidden files collected while hidden files are hidden. */
+#define HIDDEN_BUDGET 10000
+
+/* Time in milliseconds after which recursive listings stop descending further. 0 means no limit. */
+#define TIME_BUDGET 0
+
+/* Number of files after which recursive listings stop descending further. 0 means no limit. */
+#define ENTRY_BUDGET 0
+
 /* Treat the parent directory (..) as the current directory when opening it. */
 #define OPEN_PARENT_AS_SELF false
 
@@ -34,6 +70,9 @@
 /* Sort file by depth: files with lower depth first. */
 #define SORT_BY_DEPTH false
 
+/* Sort file names naturally ("file2" before "file10") and by the rules of the current locale. */
+#define SORT_NATURAL false
+
 /* Print the file path instead of opening the file. */
 #define STDOUT_MODE false
 
@@ -46,6 +85,9 @@
 /* Read paths to display from stdin. */
 #define STDIN_MODE false
 
+/* Paths on stdin are separated by NUL characters instead of newlines. */
+#define STDIN_NULL false
+
 /* Add executables from $PATH to the cmds. */
 #define SEARCH_PATH_FOR_CMDS false
 
@@ -62,6 +104,8 @@
 #define HIDE_HIDDEN_SYMBOL "[-]"
 #define SHOW_HIDDEN_SYMBOL "[+]"
 #define PATH_SEP " / "
+/* Appended to the status if a recursive listing stopped at a depth because of its budget. */
+#define TRUNCATED_MESSAGE_FORMAT " (stopped at depth %u)"
 
 /* The name to display for the parent directory. */
 #define UP_TEXT ".."
@@ -83,6 +127,8 @@
 #define OPEN_MULTI_KEY KB_CUSTOM_1
 /* Key for toggling hidden files. */
 #define TOGGLE_HIDDEN_KEY KB_CUSTOM_2
+/* Key for doubling the budget of recursive listings. */
+#define EXTEND_BUDGET_KEY KB_CUSTOM_3
 
 /* Separators for open-custom commands. */
 #define OPEN_CUSTOM_CMD_NAME_SEP ";name:"
@@ -0,0 +1,31 @@
+#ifndef FILE_BROWSER_EXCLUDE_H
+#define FILE_BROWSER_EXCLUDE_H
+
+#include <stdbool.h>
+
+/**
+ * Exclude glob patterns compiled into one matcher. Matches valid UTF-8 base names exactly like matching them to every
+ * pattern with g_pattern_match does.
+ * Patterns without wildcards are looked up in a hash set, patterns of a star followed by a literal suffix are looked
+ * up by the suffixes of the name, and all other patterns are run at once as one automaton over the characters of the
+ * name. Bytes of names and patterns that are not valid UTF-8 are matched as one character each.
+ * A matcher can be used from multiple threads at once.
+ */
+typedef struct FBExcludeMatcher FBExcludeMatcher;
+
+/**
+ * Compiles a NULL-terminated array of glob patterns. Returns NULL if there are no patterns.
+ */
+FBExcludeMatcher *exclude_matcher_new ( const char * const *globs );
+
+/**
+ * Returns true if the base name matches any of the patterns.
+ */
+bool exclude_matcher_match ( const FBExcludeMatcher *matcher, const char *basename );
+
+/**
+ * Frees the matcher.
+ */
+void exclude_matcher_free ( FBExcludeMatcher *matcher );
+
+#endif
@@ -1,8 +1,6 @@
 #ifndef FILE_BROWSER_FILES_H
 #define FILE_BROWSER_FILES_H
 
-#include <ftw.h>
-
 #include "types.h"
 
 /**
@@ -10,20 +8,83 @@
  */
 void load_files ( FileBrowserFileData *fd );
 
+/**
+ * Sorts the file list according to the sort options. The parent directory stays first.
+ */
+void sort_files ( FileBrowserFileData *fd );
+
+/**
+ * Appends files to the file list, expanding the list if necessary.
+ */
+void insert_files ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd );
+
+/**
+ * Sorts the given files and merges them into the sorted file list. The names of the files must be allocated from
+ * the file list's arena.
+ */
+void merge_files ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd );
+
+/**
+ * Removes the files whose names are in the set names from the file list, along with the files below them.
+ */
+void remove_files ( GHashTable *names, FileBrowserFileData *fd );
+
+/**
+ * Updates which files are shown after show_hidden changed, without loading the files again.
+ */
+void filter_files ( FileBrowserFileData *fd );
+
+/**
+ * Returns the number of shown files.
+ */
+unsigned int get_num_shown_files ( const FileBrowserFileData *fd );
+
+/**
+ * Returns a shown file by its index among the shown files.
+ */
+FBFile *get_shown_file ( const FileBrowserFileData *fd, unsigned int index );
+
+/**
+ * Returns true if a path relative to the current directory has a hidden component.
+ */
+bool is_hidden_path ( const char *rel_path );
+
+/**
+ * Returns true if a file name or the name of one of its parent directories is hidden.
+ */
+bool is_hidden_name ( const FBName *name );
+
+/**
+ * Returns the displayed name of a file. The name has to be freed.
+ */
+char *get_file_name ( const FileBrowserFileData *fd, const FBFile *file );
+
+/**
+ * Returns the absolute path of a file. The path has to be freed.
+ */
+char *get_file_path ( const FileBrowserFileData *fd, const FBFile *file );
+
 /**
  * Loads the file list from stdin.
  * Paths must either be absolute or relative to the current directory.
  * Paths will be displayed as they are given from stdin, including the order.
  * It is not checked if the paths actually exist.
- * Paths must be separated by newlines.
+ * Paths must be separated by separator, usually a newline or a NUL character. Empty paths are skipped.
+ * The types of the files are determined in the background afterwards, until then they are UNKNOWN.
  */
-void load_files_from_stdin ( FileBrowserFileData *fd );
+void load_files_from_stdin ( FileBrowserFileData *fd, char separator );
 
 /**
  * Simplifies the given path (e.g. removes "..") and changes directory to it.
  */
 void change_dir ( char *path, FileBrowserFileData *fd );
 
+/**
+ * Matches a base name to the specified exclude glob patterns.
+ * Returns false if the base name matches any of the patterns.
+ */
+bool match_glob_patterns ( const char *basename, FileBrowserFileData *fd );
+
 /**
  * Destroys the file data.
  */
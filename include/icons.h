@@ -11,13 +11,15 @@
 void destroy_icon_data ( FileBrowserIconData *id );
 
 /**
- * Requests icons for the file from rofi's icon fetcher.
+ * Requests icons for the file with the given absolute path from rofi's icon fetcher.
+ * The returned requests have to be freed.
  */
-void request_icons_for_file ( FBFile *fbfile, int icon_size, FileBrowserIconData *id );
+FBIconRequests *request_icons_for_file ( const FBFile *fbfile, const char *path, int icon_size,
+        FileBrowserIconData *id );
 
 /**
- * Fetches requested icons for the file from rofi's icon fetcher.
+ * Fetches requested icons for a file from rofi's icon fetcher.
  */
-cairo_surface_t *fetch_icon_for_file ( FBFile *fbfile );
+cairo_surface_t *fetch_icon_for_file ( const FBIconRequests *requests );
 
 #endif
@@ -0,0 +1,58 @@
+#ifndef FILE_BROWSER_IGNORE_H
+#define FILE_BROWSER_IGNORE_H
+
+#include <stdbool.h>
+
+/**
+ * Rules of .gitignore, .ignore and .git/info/exclude files, loaded per directory while the directories are listed.
+ * The rules of a directory are stacked on the rules of its parent directory, so a file is matched to the rules of its
+ * own directory first and to the rules of the directories above it afterwards. Within a directory, rules of .ignore
+ * take precedence over rules of .gitignore, which take precedence over rules of .git/info/exclude, and later rules
+ * take precedence over earlier ones. A directory with a .git entry starts a new stack, like a nested repository.
+ * Patterns follow the gitignore syntax ('!' negates, a trailing '/' only matches directories, a '/' at the start or in
+ * the middle anchors the pattern to the directory of its file, '**' matches any number of directories).
+ * .git directories are always ignored.
+ */
+typedef struct FBIgnore FBIgnore;
+
+/**
+ * The rules of one directory and the directories above it. NULL if there are no rules.
+ */
+typedef struct FBIgnoreDir FBIgnoreDir;
+
+/**
+ * Creates an empty set of ignore rules. The rules of all directories loaded with it are freed with it.
+ * Directories can be loaded from multiple threads at once.
+ */
+FBIgnore *ignore_new ( void );
+
+/**
+ * Loads the rules of the directories above path, up to the root of the repository path is in.
+ * Returns NULL if path is not inside a repository.
+ */
+const FBIgnoreDir *ignore_load_ancestors ( FBIgnore *ignore, const char *path );
+
+/**
+ * Loads the rules of a directory on top of the rules of its parent directory. dfd is an open descriptor of the
+ * directory, or -1 to open the ignore files by path.
+ * Returns parent if the directory has no ignore files.
+ */
+const FBIgnoreDir *ignore_load_dir ( FBIgnore *ignore, const FBIgnoreDir *parent, int dfd, const char *path );
+
+/**
+ * Returns true if the file with the given absolute path is ignored by the rules of its directory.
+ * is_dir tells if the file is a directory, which is matched by patterns with a trailing '/'.
+ */
+bool ignore_match ( const FBIgnoreDir *dir, const char *path, bool is_dir );
+
+/**
+ * Returns true if a file with this name contains ignore rules.
+ */
+bool ignore_is_rules_file ( const char *basename );
+
+/**
+ * Frees the ignore rules.
+ */
+void ignore_free ( FBIgnore *ignore );
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FILE_BROWSER_LRU_H
+#define FILE_BROWSER_LRU_H
+
+#include "types.h"
+
+/**
+ * Recently visited listings, least recently used listings are dropped first when the memory budget is exceeded.
+ * Only listings with a depth of 1 are kept, since a directory's mtime does not change with its subdirectories.
+ */
+typedef struct FBLru FBLru;
+
+/**
+ * Creates an empty LRU with the given memory budget in bytes.
+ */
+FBLru *lru_new ( size_t budget );
+
+/**
+ * Remembers the state of the current directory before its files are loaded.
+ * Only listings that were started with lru_begin are stored.
+ */
+void lru_begin ( FBLru *lru, FileBrowserFileData *fd );
+
+/**
+ * Takes over the current file list if it is complete and can be validated later.
+ * The file list of fd is left empty.
+ */
+void lru_store ( FBLru *lru, FileBrowserFileData *fd );
+
+/**
+ * Restores the listing of the current directory if it is in the LRU and the directory did not change since.
+ * The current file list must be empty. Returns false if the files have to be loaded.
+ */
+bool lru_restore ( FBLru *lru, FileBrowserFileData *fd );
+
+/**
+ * Frees the LRU and all listings in it.
+ */
+void lru_free ( FBLru *lru );
+
+#endif
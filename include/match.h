@@ -0,0 +1,68 @@
+#ifndef FILE_BROWSER_MATCH_H
+#define FILE_BROWSER_MATCH_H
+
+#include <stdbool.h>
+#include <rofi/helper.h>
+
+#include "types.h"
+
+/**
+ * Match keys of the files of a file list, by index: the displayed names as valid UTF-8, each followed by a copy with
+ * ASCII letters lowercased, in one buffer. The keys are also the names that are displayed.
+ * Tokens that are plain literals are matched to the keys with a substring search instead of their regex, and tokens of
+ * rofi's fuzzy matching method by searching their characters in order. Caseless tokens are searched in the lowercased
+ * copy, and only fall back to the regex if they are not found in a name with non-ASCII characters, which can match
+ * ASCII letters caselessly (e.g. the Kelvin sign).
+ * The trigrams of the lowercased copies are indexed, and the bytes of each key are summed up in a signature. At the
+ * start of a query, the keys that contain all trigrams of its literal tokens and all bytes of its literal and fuzzy
+ * tokens are found once, and all other keys are rejected without matching them.
+ * If rofi normalizes names before matching them, keys with non-ASCII characters are matched by helper_token_match.
+ * Keys are only added and reset from the main thread, and can be matched from multiple threads at once in between.
+ */
+typedef struct FBMatchKeys FBMatchKeys;
+
+/**
+ * Creates empty match keys.
+ */
+FBMatchKeys *match_keys_new ( void );
+
+/**
+ * Adds the keys of the first num_files files of the file list that don't have keys yet. Files are only ever appended
+ * to the file list until the keys are reset.
+ */
+void match_keys_update ( FBMatchKeys *keys, const FileBrowserFileData *fd, unsigned int num_files );
+
+/**
+ * Removes all keys, e.g. after the file list was reordered.
+ */
+void match_keys_reset ( FBMatchKeys *keys );
+
+/**
+ * Waits until the trigrams of all keys are indexed, which otherwise happens in the background. Keys that are not
+ * indexed yet are always candidates of a query. Must be called on the main thread.
+ */
+void match_keys_wait_indexed ( FBMatchKeys *keys );
+
+/**
+ * Returns the number of files with keys. Files from this index on have no keys yet.
+ */
+unsigned int match_keys_count ( const FBMatchKeys *keys );
+
+/**
+ * Returns the key of a file, its displayed name as valid UTF-8.
+ */
+const char *match_keys_get ( const FBMatchKeys *keys, unsigned int index );
+
+/**
+ * Returns true if the key of a file matches all tokens, like helper_token_match does for the displayed name.
+ * The candidates of the tokens are found when the first key is matched to them, and kept until the keys change or
+ * the key is matched to different tokens.
+ */
+bool match_keys_match ( FBMatchKeys *keys, unsigned int index, rofi_int_matcher * const *tokens );
+
+/**
+ * Frees the keys.
+ */
+void match_keys_free ( FBMatchKeys *keys );
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef FILE_BROWSER_MOUNTS_H
+#define FILE_BROWSER_MOUNTS_H
+
+#include <stdbool.h>
+
+/**
+ * Depth limits of mounts, given as "<path>:<depth>". A limit applies to the directory at its path and all directories
+ * below it. If limits of several paths apply to a directory, the limit of the longest path is used.
+ */
+typedef struct FBMountDepths FBMountDepths;
+
+/**
+ * Parses a NULL-terminated array of depth limits. Invalid limits are reported and skipped.
+ * Returns NULL if there are no valid limits.
+ */
+FBMountDepths *mount_depths_new ( const char * const *specs );
+
+/**
+ * Returns the depth limit that applies to an absolute path, or -1 if there is none.
+ */
+int mount_depths_get ( const FBMountDepths *depths, const char *path );
+
+/**
+ * Frees the depth limits.
+ */
+void mount_depths_free ( FBMountDepths *depths );
+
+/**
+ * Returns true if the path is on a network or FUSE file system (NFS, SMB, sshfs, ...), where listing files can block
+ * for a long time.
+ */
+bool is_slow_mount ( const char *path );
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef FILE_BROWSER_NAMES_H
+#define FILE_BROWSER_NAMES_H
+
+#include "types.h"
+
+/**
+ * Allocates the name of a file in the given parent directory (NULL for the current directory) from an arena.
+ */
+const FBName *new_name ( FBArena *arena, const FBName *parent, const char *basename );
+
+/**
+ * Like new_name, but takes the length of basename, which does not need to be terminated.
+ */
+const FBName *new_name_len ( FBArena *arena, const FBName *parent, const char *basename, size_t len );
+
+/**
+ * Writes a file's relative name to buffer, which must have room for name->len + 1 characters.
+ */
+void write_name ( const FBName *name, char *buffer );
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FILE_BROWSER_PREFILTER_H
+#define FILE_BROWSER_PREFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Instruction sets prefilter_match can use, from the slowest to the fastest.
+ */
+typedef enum {
+    PREFILTER_SCALAR,
+    PREFILTER_SSE2,
+    PREFILTER_AVX2,
+} FBPrefilterMethod;
+
+/**
+ * Returns the signature of a text: a bitmask of the classes of its bytes. ASCII letters (regardless of their case)
+ * and digits have a class each, all other bytes share the remaining classes.
+ * A text can only contain the characters of another text if its signature has all bits of the other signature.
+ */
+uint64_t prefilter_signature ( const char *text, size_t len );
+
+/**
+ * Clears the bits of the texts whose signatures don't have all bits of query in bitmap, which has a bit per text.
+ * Uses AVX2 or SSE2 instructions where they are available.
+ */
+void prefilter_match ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap );
+
+/**
+ * Returns the fastest instruction set prefilter_match can use on this CPU.
+ */
+FBPrefilterMethod prefilter_get_method ( void );
+
+/**
+ * Like prefilter_match, but uses the given instruction set, which must not be faster than prefilter_get_method ().
+ */
+void prefilter_match_with ( FBPrefilterMethod method, const uint64_t *signatures, unsigned int num, uint64_t query,
+        uint64_t *bitmap );
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef FILE_BROWSER_RESOLVE_H
+#define FILE_BROWSER_RESOLVE_H
+
+#include <sys/types.h>
+
+/**
+ * A file whose type is to be determined.
+ */
+typedef struct {
+    /* Directory file descriptor the path is relative to, or AT_FDCWD. */
+    int dfd;
+    /* Path of the file, relative to dfd or absolute. */
+    const char *path;
+    /* 0 to follow symbolic links, AT_SYMLINK_NOFOLLOW to not follow them. */
+    int flags;
+    /* Set to 0 if the file could be stat'ed, to the errno value otherwise. */
+    int error;
+    /* Set to the file type bits (S_IFMT) of the file's mode if the file could be stat'ed. */
+    mode_t mode;
+} FBResolveRequest;
+
+/**
+ * Determines the types of the given files.
+ * Uses batched statx requests through io_uring where available, and stats the files on a thread pool otherwise.
+ * Can be called from multiple threads at once.
+ */
+void resolve_types ( FBResolveRequest *requests, unsigned int num_requests );
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FILE_BROWSER_SORT_H
+#define FILE_BROWSER_SORT_H
+
+#include "types.h"
+
+/**
+ * Sorts files according to the sort options of the file data.
+ * Large arrays are radix sorted by keys that pack the depth, the type and the first bytes of the name. Large runs of
+ * files with equal keys are radix sorted by the following bytes of their names, and only small runs are sorted by
+ * comparing the files. Arrays with many more files are sorted in parts on num_threads threads, and the parts are
+ * merged on all threads.
+ * When sorting naturally, the collation keys of the names that don't have one yet are computed first and allocated
+ * from the names arena of the file data. Only the first bytes of the collation keys are radix sorted then.
+ */
+void sort_file_array ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd );
+
+/**
+ * Returns the compare function for the sort options of the file data, which must be passed as its user data.
+ * Names must have collation keys when sorting naturally.
+ */
+GCompareDataFunc get_compare_func ( const FileBrowserFileData *fd );
+
+#endif
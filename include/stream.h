@@ -0,0 +1,28 @@
+#ifndef FILE_BROWSER_STREAM_H
+#define FILE_BROWSER_STREAM_H
+
+#include "types.h"
+
+/**
+ * Starts listing the files of the current directory in a background thread.
+ * Found files are appended to the file list in chunks from the main loop, and rofi reloads after every chunk.
+ * When the listing is done, the file list is sorted, unless keep_order is set.
+ * The listing uses a snapshot of the options, later changes to fd only take effect with the next listing.
+ */
+void stream_files ( FileBrowserFileData *fd );
+
+/**
+ * Determines the types of the files in the file list in a background thread, e.g. of paths read from stdin.
+ * The types are updated in place in batches, and rofi reloads after every batch. The order of the file list is kept.
+ * Files that can't be stat'ed keep their type. The file list must not change until the types are all determined.
+ */
+void stream_types ( FileBrowserFileData *fd );
+
+/**
+ * Stops the background listing of the file data, if there is one, without waiting for it to return.
+ * The names of the files that have already been appended to the file list are freed with the listing, so the file
+ * list has to be freed before the main loop runs again.
+ */
+void cancel_stream ( FileBrowserFileData *fd );
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef FILE_BROWSER_TRIGRAM_H
+#define FILE_BROWSER_TRIGRAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Index of the trigrams (three consecutive bytes) of texts with ascending ids. Each trigram has a posting list of the
+ * ids of the texts that contain it, stored as deltas in variable-length bytes.
+ * Texts are only added from one thread, and the index can be searched from multiple threads at once in between.
+ */
+typedef struct FBTrigramIndex FBTrigramIndex;
+
+/**
+ * Creates an empty index.
+ */
+FBTrigramIndex *trigram_index_new ( void );
+
+/**
+ * Adds the trigrams of a text. id must be greater than the ids of all texts added before.
+ */
+void trigram_index_add ( FBTrigramIndex *index, unsigned int id, const char *text, size_t len );
+
+/**
+ * Narrows ids to the ids of the texts that contain all trigrams of text, in ascending order. If narrowed is false, ids
+ * holds no ids yet and stands for all texts. ids must have room for the ids of all texts.
+ * Returns false and leaves ids unchanged if text is too short to have trigrams.
+ */
+bool trigram_index_narrow ( const FBTrigramIndex *index, const char *text, unsigned int *ids, unsigned int *num_ids,
+        bool narrowed );
+
+/**
+ * Removes all texts.
+ */
+void trigram_index_reset ( FBTrigramIndex *index );
+
+/**
+ * Frees the index.
+ */
+void trigram_index_free ( FBTrigramIndex *index );
+
+#endif
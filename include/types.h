@@ -5,6 +5,8 @@
 #include <gmodule.h>
 #include <stdint.h>
 
+#include "arena.h"
+
 // ================================================================================================================= //
 
 typedef enum FBFileType {
@@ -15,23 +17,40 @@ typedef enum FBFileType {
     UNKNOWN
 } FBFileType;
 
+/* Name of a file relative to the current directory, allocated in the file list's arena.
+ * Files below the current directory share the names of their parent directories. */
+typedef struct FBName {
+    /* Name of the parent directory, NULL for files in the current directory. */
+    const struct FBName *parent;
+    /* Collation key of the basename for sorting naturally, allocated in the same arena.
+     * NULL until the name is sorted naturally for the first time. */
+    const char *collate_key;
+    /* Length of the whole relative name. */
+    unsigned int len;
+    /* Name of the file in its parent directory. */
+    char basename[];
+} FBName;
+
+/* A listed file. Kept at 16 bytes, sorting and matching stride over arrays of files. */
 typedef struct {
-    /* Absolute path of the file. */
-    char *path;
-    /* Path of the file relative to the current dir.
-     * This only points to path with an offset,
-     * except for the parent dir's name, which points to up_text. */
-    char *name;
-    /* Type of the file. */
-    enum FBFileType type;
+    /* Name of the file relative to the current directory, or an absolute path given on stdin.
+     * NULL for the parent dir, whose name is up_text. */
+    const FBName *name;
     /* Depth of the file when listing recursively. */
     unsigned int depth;
-
-    /* Rofi icon fetcher request IDs for possible icons. */
-    uint32_t *icon_fetcher_requests;
-    unsigned int num_icon_fetcher_requests;
+    /* Type of the file, an FBFileType. */
+    uint8_t type;
+    /* The file or one of its parent directories below the current directory is hidden. */
+    bool hidden;
 } FBFile;
 
+/* Rofi icon fetcher requests of a displayed file. */
+typedef struct {
+    unsigned int num_requests;
+    /* Request IDs for possible icons, in order of preference. */
+    uint32_t requests[];
+} FBIconRequests;
+
 typedef struct {
     /* Absolute path of the current directory. */
     char *current_dir;
@@ -41,28 +60,90 @@ typedef struct {
     unsigned int num_files;
     /* Size of the files array. */
     unsigned int size_files;
-    /* Glob patterns to exclude dirs / files, not NULL-terminated. */
-    GPatternSpec **exclude_patterns;
-    /* Number of exclude glob patters. */
-    unsigned int num_exclude_patterns;
+    /* Names of the files. */
+    FBArena names;
+    /* Icon requests of the files that were displayed by their names, NULL if no icons were requested.
+     * Only valid as long as the names are. */
+    GHashTable *icons;
+    /* Indices of the files that are shown, NULL if all files are shown.
+     * Hidden files are always listed, hiding them only changes this view. */
+    unsigned int *shown;
+    /* Number of shown files if shown is not NULL. */
+    unsigned int num_shown;
+    /* Size of the shown array. */
+    unsigned int size_shown;
+    /* Matcher of the glob patterns to exclude dirs / files, NULL if there are none. */
+    struct FBExcludeMatcher *exclude_matcher;
+    /* The exclude glob patterns as strings, NULL-terminated. */
+    char **exclude_globs;
+    /* Skip files matched by .gitignore, .ignore and .git/info/exclude files. */
+    bool use_ignore_files;
     /* Follow symlinks. */
     bool follow_symlinks;
     /* Show hidden files. */
     bool show_hidden;
+    /* Maximum number of hidden files collected while hidden files are hidden.
+     * Hidden directories are not descended into once it is reached. */
+    unsigned int hidden_budget;
+    /* Hidden directories were not descended into because of hidden_budget. */
+    bool hidden_pruned;
+    /* Time in milliseconds and number of files after which recursive listings stop descending further.
+     * Directories are then read level by level, so the listing is complete up to some depth. 0 means no limit. */
+    unsigned int time_budget;
+    unsigned int entry_budget;
+    /* Depth of the first directories that were not read because of the budget, 0 if the listing is complete. */
+    unsigned int truncated_depth;
     /* Only show dirs. */
     bool only_dirs;
     /* Only show files. */
     bool only_files;
-    /* Scan files recursively up to a given depth. 0 means no limit. */
+    /* Scan files recursively up to a given depth. 0 means no limit.
+     * Set from depth_option and the depth limit of the current directory's mount when the files are loaded. */
     int depth;
+    /* The depth given by the options. */
+    int depth_option;
+    /* Depth limits of specific mounts, NULL if there are none. */
+    struct FBMountDepths *mount_depths;
+    /* Depth limit of network and FUSE mounts without a specific limit. 0 means no limit. */
+    unsigned int slow_fs_depth;
+    /* The current directory is on a network or FUSE mount. Its files are always listed in the background. */
+    bool slow_fs;
+    /* Number of threads to scan files recursively with. 0 means one thread per processor. */
+    unsigned int num_threads;
     /* Show directories first, inaccessible files last. */
     bool sort_by_type;
     /* Show files with lower depth first. */
     bool sort_by_depth;
+    /* Sort names naturally ("file2" before "file10") and by the rules of the current locale. */
+    bool sort_natural;
     /* Hide the parent directory (..). */
     bool hide_parent;
     /* Text for the parent directory (..). */
     char *up_text;
+    /* List files in the background and show them while they are listed. */
+    bool stream;
+    /* Keep recursive listings in a persistent cache and only read changed directories again. */
+    bool use_cache;
+    /* Directory of the cache files. */
+    char *cache_dir;
+    /* Memory budget for recently visited listings in MiB. 0 disables keeping them. */
+    unsigned int lru_memory;
+    /* Recently visited listings, NULL until files are loaded the first time. */
+    struct FBLru *lru;
+    /* Update the file list when files are created or deleted. */
+    bool watch;
+    /* Maximum number of directories watched for changes. */
+    unsigned int watch_limit;
+    /* Watches of the current directory and its listed subdirectories, NULL if there are none. */
+    struct FBWatch *active_watch;
+    /* Background listing of the current directory, NULL if there is none. */
+    struct FBStream *active_stream;
+    /* Keys the files are matched to the entered text with, NULL until text is entered the first time. */
+    struct FBMatchKeys *match_keys;
+    /* Don't reorder the file list, e.g. while a file of it is opened with a custom command. */
+    bool keep_order;
+    /* The file list has been loaded, but its sorting was postponed because of keep_order. */
+    bool unsorted;
 } FileBrowserFileData;
 
 // ================================================================================================================= //
@@ -99,6 +180,8 @@ typedef struct {
     FBKey open_multi_key;
     /* Key for toggling hidden files. */
     FBKey toggle_hidden_key;
+    /* Key for doubling the budget of recursive listings. */
+    FBKey extend_budget_key;
 } FileBrowserKeyData;
 
 // ================================================================================================================= //
@@ -106,7 +189,7 @@ typedef struct {
 typedef struct {
     /* The command. */
     char *cmd;
-    /* A name to display instead of the command, or a copy of cmd. */
+    /* The name to display, valid UTF-8. Made from the command if no name was given. */
     char *name;
     /* Name of the icon, or NULL for no icon. */
     char *icon_name;
@@ -132,6 +215,8 @@ typedef struct {
     bool open_parent_as_self;
     /* Read paths to display from stdin, implies no_descend. */
     bool stdin_mode;
+    /* Paths on stdin are separated by NUL characters instead of newlines. */
+    bool stdin_null;
     /* Status bar format. */
     char *show_hidden_symbol;
     char *hide_hidden_symbol;
@@ -158,6 +243,21 @@ typedef struct {
     bool show_cmds;
     /* Add executables from $PATH to the cmds the next time they are shown. */
     bool search_path_for_cmds;
+
+    /* ---- Status bar ---- */
+    /* The last status bar message, and the directory, hidden state and truncated depth it was built for. */
+    char *status_message;
+    char *status_dir;
+    bool status_show_hidden;
+    unsigned int status_truncated_depth;
+
+    /* ---- Allocation counts ---- */
+    /* Count the strings allocated for rofi per frame and log the counts, set if debug messages are enabled. */
+    bool count_allocs;
+    /* Strings allocated since the last count was logged. */
+    unsigned int frame_allocs;
+    /* Idle source that logs the count, 0 if none is scheduled. */
+    guint frame_allocs_source;
 } FileBrowserModePrivateData;
 
 #endif
@@ -12,10 +12,22 @@ char *get_canonical_abs_path ( char *path, char *current_dir );
  */
 void print_err ( const char *format, ... );
 
+/**
+ * Returns the number of file descriptors that can be kept open while listing files, derived from the RLIMIT_NOFILE
+ * limit of the process.
+ */
+unsigned int get_fd_budget ( void );
+
 /**
  * Counts the elements in a NULL-terminated string array.
  * If the array is NULL, 0 is returned.
  */
 unsigned int count_strv ( const char **array );
 
+/**
+ * Makes rofi reload the entries of the current view. Must be called from the main thread.
+ * Not declared in rofi's plugin headers, but exported by rofi.
+ */
+extern void rofi_view_reload ( void );
+
 #endif
@@ -0,0 +1,30 @@
+#ifndef FILE_BROWSER_WALKER_H
+#define FILE_BROWSER_WALKER_H
+
+#include "types.h"
+
+/**
+ * Lists the files below the current directory with the given number of threads (0 for one per processor) and appends
+ * them to the file list, except excluded, ignored and too deep files. Sets hidden_pruned and truncated_depth when
+ * directories were left unread. Walks of different file data can run at the same time.
+ */
+void walk_files ( FileBrowserFileData *fd, unsigned int num_threads );
+
+/**
+ * Called from the walker's threads with a chunk of found files.
+ * The callback must not keep the files array itself. The files' names stay valid, and are moved to the names arena
+ * passed to walk_files_chunked when the walk is done.
+ */
+typedef void ( *FBWalkChunkFunc ) ( FBFile *files, unsigned int num_files, void *user_data );
+
+/**
+ * Like walk_files, but passes the found files to chunk_func in chunks while the walk is running instead of appending
+ * them to the file list. A thread passes on its files when it has collected WALK_CHUNK_SIZE of them, or when it has
+ * finished a directory and did not pass on any files for a while, so the first files arrive quickly.
+ * The walk stops early as soon as *cancelled becomes non-zero. The file list of fd is not touched, fd only provides
+ * the options. The names of the found files are allocated by the walker's threads and moved to names at the end.
+ */
+void walk_files_chunked ( FileBrowserFileData *fd, unsigned int num_threads, FBArena *names,
+        FBWalkChunkFunc chunk_func, void *user_data, const gint *cancelled );
+
+#endif
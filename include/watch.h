@@ -0,0 +1,24 @@
+#ifndef FILE_BROWSER_WATCH_H
+#define FILE_BROWSER_WATCH_H
+
+#include "types.h"
+
+/**
+ * Watches the current directory and the listed subdirectories whose files are listed for created and deleted files,
+ * up to watch_limit directories. Does nothing if watch is not set or inotify is not available.
+ * Changes are applied to the sorted file list from the main loop, and rofi reloads after every batch of changes.
+ * While keep_order is set, changes are collected and only applied by flush_watch.
+ */
+void watch_files ( FileBrowserFileData *fd );
+
+/**
+ * Applies the changes that were collected while keep_order was set. The file list must be sorted.
+ */
+void flush_watch ( FileBrowserFileData *fd );
+
+/**
+ * Stops watching the directories of the file data, if they are watched.
+ */
+void cancel_watch ( FileBrowserFileData *fd );
+
+#endif
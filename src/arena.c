@@ -0,0 +1,116 @@
+#include <stdbool.h>
+#include <gmodule.h>
+
+#include "arena.h"
+
+/**
+ * Size of the chunks allocations are carved from.
+ */
+#define ARENA_CHUNK_SIZE ( 64 * 1024 )
+
+/**
+ * Alignment of allocations.
+ */
+#define ARENA_ALIGN ( sizeof ( void * ) )
+
+typedef struct FBArenaChunk {
+    struct FBArenaChunk *next;
+    /* Size of data. */
+    size_t size;
+    /* Aligned for pointers, since the chunk header is a multiple of the pointer size. */
+    char data[];
+} FBArenaChunk;
+
+/**
+ * Allocates a chunk with at least the given size of data.
+ */
+static FBArenaChunk *new_chunk ( size_t size );
+
+// ================================================================================================================= //
+
+void arena_init ( FBArena *arena )
+{
+    arena->chunks = NULL;
+    arena->pos = NULL;
+    arena->end = NULL;
+    arena->size = 0;
+}
+
+void *arena_alloc ( FBArena *arena, size_t size )
+{
+    size = ( size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+
+    if ( ( size_t ) ( arena->end - arena->pos ) < size ) {
+        /* Large allocations get their own chunk, so the free space of the current chunk is not lost. */
+        if ( size > ARENA_CHUNK_SIZE / 4 && arena->chunks != NULL ) {
+            FBArenaChunk *chunk = new_chunk ( size );
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+            arena->size += size;
+            return chunk->data;
+        }
+
+        FBArenaChunk *chunk = new_chunk ( MAX ( size, ARENA_CHUNK_SIZE ) );
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->pos = chunk->data;
+        arena->end = chunk->data + chunk->size;
+        arena->size += chunk->size;
+    }
+
+    void *ptr = arena->pos;
+    arena->pos += size;
+    return ptr;
+}
+
+void arena_merge ( FBArena *dst, FBArena *src )
+{
+    if ( src->chunks == NULL ) {
+        return;
+    } else if ( dst->chunks == NULL ) {
+        *dst = *src;
+    } else {
+        /* The current chunk of dst stays current, the chunks of src are only kept. */
+        FBArenaChunk *last = src->chunks;
+        while ( last->next != NULL ) {
+            last = last->next;
+        }
+        last->next = dst->chunks->next;
+        dst->chunks->next = src->chunks;
+        dst->size += src->size;
+    }
+    arena_init ( src );
+}
+
+void arena_reset ( FBArena *arena )
+{
+    if ( arena->chunks == NULL ) {
+        return;
+    }
+
+    FBArenaChunk *chunk = arena->chunks->next;
+    while ( chunk != NULL ) {
+        FBArenaChunk *next = chunk->next;
+        g_free ( chunk );
+        chunk = next;
+    }
+    arena->chunks->next = NULL;
+    arena->pos = arena->chunks->data;
+    arena->end = arena->chunks->data + arena->chunks->size;
+    arena->size = arena->chunks->size;
+}
+
+void arena_clear ( FBArena *arena )
+{
+    arena_reset ( arena );
+    g_free ( arena->chunks );
+    arena_init ( arena );
+}
+
+static FBArenaChunk *new_chunk ( size_t size )
+{
+    FBArenaChunk *chunk = g_malloc ( sizeof ( FBArenaChunk ) + size );
+    chunk->next = NULL;
+    chunk->size = size;
+    return chunk;
+}
@@ -0,0 +1,269 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+#include <glib/gstdio.h>
+
+#include "types.h"
+#include "util.h"
+#include "cache.h"
+
+/**
+ * Magic bytes at the start of a cache file. Changes whenever the format changes.
+ */
+#define CACHE_MAGIC "FBCACHE1"
+#define CACHE_MAGIC_LEN 8
+
+/**
+ * Records are aligned to 8 bytes, so their headers can be accessed directly in the mapped file.
+ */
+#define CACHE_ALIGN( size ) ( ( ( size ) + 7 ) & ~( ( size_t ) 7 ) )
+
+struct FBCacheDir {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    uint64_t ino;
+    /* Size of the record without padding. */
+    uint32_t size;
+    /* Length of the path. */
+    uint32_t path_len;
+    /* The NUL-terminated path relative to the current directory,
+     * followed by the entries: a type byte and a NUL-terminated name each. */
+    char data[];
+};
+
+struct FBCache {
+    /* Path of the cache file. */
+    char *path;
+    /* The mapped cache file, NULL if there is none. */
+    GMappedFile *file;
+    /* Cached directories by their relative paths. Keys and values point into the mapped file. */
+    GHashTable *dirs;
+    /* Time the cache was opened, in seconds. */
+    gint64 open_time;
+};
+
+/**
+ * Builds the path of the cache file for the current directory and listing options of the file data.
+ */
+static char *get_cache_path ( FileBrowserFileData *fd );
+
+/**
+ * Reads the records of the mapped cache file into the hash table. Returns false if the file is invalid.
+ */
+static bool read_records ( FBCache *cache );
+
+// ================================================================================================================= //
+
+FBCache *cache_open ( FileBrowserFileData *fd )
+{
+    FBCache *cache = g_malloc0 ( sizeof ( FBCache ) );
+    cache->path = get_cache_path ( fd );
+    cache->dirs = g_hash_table_new ( g_str_hash, g_str_equal );
+    cache->open_time = g_get_real_time () / G_USEC_PER_SEC;
+    cache->file = g_mapped_file_new ( cache->path, false, NULL );
+
+    if ( cache->file != NULL && ! read_records ( cache ) ) {
+        g_hash_table_remove_all ( cache->dirs );
+    }
+
+    return cache;
+}
+
+const FBCacheDir *cache_lookup ( FBCache *cache, const char *rel_path, const struct stat *st )
+{
+    const FBCacheDir *dir = g_hash_table_lookup ( cache->dirs, rel_path );
+    if ( dir == NULL
+            || dir->mtime_sec != st->st_mtim.tv_sec || dir->mtime_nsec != st->st_mtim.tv_nsec
+            || dir->ctime_sec != st->st_ctim.tv_sec || dir->ctime_nsec != st->st_ctim.tv_nsec
+            || dir->ino != st->st_ino ) {
+        return NULL;
+    }
+    return dir;
+}
+
+bool cache_dir_next ( const FBCacheDir *dir, size_t *pos, const char **name, unsigned char *type )
+{
+    /* The entries start after the path. */
+    size_t offset = dir->path_len + 1 + *pos;
+    size_t end = dir->size - sizeof ( FBCacheDir );
+    if ( offset + 1 >= end ) {
+        return false;
+    }
+
+    *type = ( unsigned char ) dir->data[offset];
+    *name = &dir->data[offset + 1];
+    *pos += strlen ( *name ) + 2;
+    return true;
+}
+
+void cache_recorder_init ( FBCacheRecorder *recorder, FBCache *cache )
+{
+    recorder->cache = cache;
+    recorder->data = g_byte_array_new ();
+    recorder->dir = -1;
+    recorder->num_read = 0;
+    recorder->num_copied = 0;
+}
+
+void cache_recorder_begin ( FBCacheRecorder *recorder, const char *rel_path, const struct stat *st )
+{
+    recorder->num_read++;
+
+    gint64 racy_time = recorder->cache->open_time - 1;
+    if ( st->st_mtim.tv_sec >= racy_time || st->st_ctim.tv_sec >= racy_time ) {
+        recorder->dir = -1;
+        return;
+    }
+
+    FBCacheDir header;
+    header.mtime_sec = st->st_mtim.tv_sec;
+    header.mtime_nsec = st->st_mtim.tv_nsec;
+    header.ctime_sec = st->st_ctim.tv_sec;
+    header.ctime_nsec = st->st_ctim.tv_nsec;
+    header.ino = st->st_ino;
+    header.size = 0;
+    header.path_len = strlen ( rel_path );
+
+    recorder->dir = recorder->data->len;
+    g_byte_array_append ( recorder->data, ( const guint8 * ) &header, sizeof ( FBCacheDir ) );
+    g_byte_array_append ( recorder->data, ( const guint8 * ) rel_path, header.path_len + 1 );
+}
+
+void cache_recorder_add ( FBCacheRecorder *recorder, const char *name, unsigned char type )
+{
+    if ( recorder->dir < 0 ) {
+        return;
+    }
+    g_byte_array_append ( recorder->data, &type, 1 );
+    g_byte_array_append ( recorder->data, ( const guint8 * ) name, strlen ( name ) + 1 );
+}
+
+void cache_recorder_end ( FBCacheRecorder *recorder )
+{
+    if ( recorder->dir < 0 ) {
+        return;
+    }
+
+    FBCacheDir *dir = ( FBCacheDir * ) &recorder->data->data[recorder->dir];
+    dir->size = recorder->data->len - recorder->dir;
+
+    static const guint8 padding[8] = { 0 };
+    g_byte_array_append ( recorder->data, padding, CACHE_ALIGN ( dir->size ) - dir->size );
+    recorder->dir = -1;
+}
+
+void cache_recorder_copy ( FBCacheRecorder *recorder, const FBCacheDir *dir )
+{
+    g_byte_array_append ( recorder->data, ( const guint8 * ) dir, CACHE_ALIGN ( dir->size ) );
+    recorder->num_copied++;
+}
+
+void cache_recorder_clear ( FBCacheRecorder *recorder )
+{
+    g_byte_array_free ( recorder->data, true );
+    recorder->data = NULL;
+}
+
+void cache_save ( FBCache *cache, FBCacheRecorder *recorders, unsigned int num_recorders )
+{
+    unsigned int num_read = 0;
+    unsigned int num_copied = 0;
+    for ( unsigned int i = 0; i < num_recorders; i++ ) {
+        num_read += recorders[i].num_read;
+        num_copied += recorders[i].num_copied;
+    }
+    if ( num_read == 0 && num_copied == g_hash_table_size ( cache->dirs ) ) {
+        return;
+    }
+
+    char *dir = g_path_get_dirname ( cache->path );
+    g_mkdir_with_parents ( dir, 0700 );
+    g_free ( dir );
+
+    /* Write to a temporary file first, the old cache file may still be mapped by other instances. */
+    char *tmp_path = g_strconcat ( cache->path, ".XXXXXX", NULL );
+    int tmp_fd = g_mkstemp ( tmp_path );
+    FILE *file = tmp_fd >= 0 ? fdopen ( tmp_fd, "wb" ) : NULL;
+    if ( file == NULL ) {
+        print_err ( "Could not write the cache file: \"%s\"\n", cache->path );
+        if ( tmp_fd >= 0 ) {
+            close ( tmp_fd );
+            g_unlink ( tmp_path );
+        }
+        g_free ( tmp_path );
+        return;
+    }
+
+    bool ok = fwrite ( CACHE_MAGIC, 1, CACHE_MAGIC_LEN, file ) == CACHE_MAGIC_LEN;
+    for ( unsigned int i = 0; i < num_recorders && ok; i++ ) {
+        GByteArray *data = recorders[i].data;
+        ok = fwrite ( data->data, 1, data->len, file ) == data->len;
+    }
+    ok = fclose ( file ) == 0 && ok;
+
+    if ( ! ok || g_rename ( tmp_path, cache->path ) != 0 ) {
+        print_err ( "Could not write the cache file: \"%s\"\n", cache->path );
+        g_unlink ( tmp_path );
+    }
+    g_free ( tmp_path );
+}
+
+void cache_close ( FBCache *cache )
+{
+    g_hash_table_destroy ( cache->dirs );
+    if ( cache->file != NULL ) {
+        g_mapped_file_unref ( cache->file );
+    }
+    g_free ( cache->path );
+    g_free ( cache );
+}
+
+static char *get_cache_path ( FileBrowserFileData *fd )
+{
+    /* Every option that changes which files are listed is part of the key.
+     * Hidden files are always listed, and pruned listings are not cached. */
+    GString *key = g_string_new ( fd->current_dir );
+    g_string_append_printf ( key, "\n%d %d %d %d", fd->depth, fd->only_dirs, fd->only_files, fd->follow_symlinks );
+    for ( char **glob = fd->exclude_globs; glob != NULL && *glob != NULL; glob++ ) {
+        g_string_append_c ( key, '\n' );
+        g_string_append ( key, *glob );
+    }
+
+    char *name = g_compute_checksum_for_string ( G_CHECKSUM_SHA1, key->str, key->len );
+    char *path = g_build_filename ( fd->cache_dir, name, NULL );
+    g_string_free ( key, true );
+    g_free ( name );
+    return path;
+}
+
+static bool read_records ( FBCache *cache )
+{
+    const char *contents = g_mapped_file_get_contents ( cache->file );
+    size_t len = g_mapped_file_get_length ( cache->file );
+    if ( len < CACHE_MAGIC_LEN || memcmp ( contents, CACHE_MAGIC, CACHE_MAGIC_LEN ) != 0 ) {
+        return false;
+    }
+
+    size_t offset = CACHE_MAGIC_LEN;
+    while ( offset < len ) {
+        if ( len - offset < sizeof ( FBCacheDir ) ) {
+            return false;
+        }
+        FBCacheDir *dir = ( FBCacheDir * ) &contents[offset];
+        /* The path and the last entry must be terminated inside the record. */
+        if ( dir->size < sizeof ( FBCacheDir ) + dir->path_len + 1 || CACHE_ALIGN ( dir->size ) > len - offset
+                || dir->data[dir->path_len] != '\0' || contents[offset + dir->size - 1] != '\0' ) {
+            return false;
+        }
+        g_hash_table_insert ( cache->dirs, dir->data, dir );
+        offset += CACHE_ALIGN ( dir->size );
+    }
+
+    return true;
+}
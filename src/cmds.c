@@ -1,4 +1,5 @@
 #include <gmodule.h>
+#include <rofi/helper.h>
 
 #include "defaults.h"
 #include "types.h"
@@ -20,6 +21,16 @@ static gint compare_cmds ( gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpoin
 
 static void add_cmds ( FBCmd *cmds, int num_cmds, FileBrowserModePrivateData *pd )
 {
+    /* Names are made valid once, instead of every time they are displayed. */
+    for ( int i = 0; i < num_cmds; i++ ) {
+        const char *name = cmds[i].name != NULL ? cmds[i].name : cmds[i].cmd;
+        if ( cmds[i].name == NULL || ! g_utf8_validate ( name, -1, NULL ) ) {
+            char *valid_name = rofi_force_utf8 ( name, strlen ( name ) );
+            g_free ( cmds[i].name );
+            cmds[i].name = valid_name;
+        }
+    }
+
     pd->cmds = g_realloc ( pd->cmds, ( pd->num_cmds + num_cmds ) * sizeof ( FBCmd ) );
     memcpy ( &pd->cmds[pd->num_cmds], cmds, num_cmds * sizeof ( FBCmd ) );
     pd->num_cmds += num_cmds;
@@ -0,0 +1,362 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <gmodule.h>
+
+#include "exclude.h"
+
+/**
+ * Number of words of automaton states that are kept on the stack while matching.
+ */
+#define STACK_WORDS 16
+
+/**
+ * Element of a glob pattern in the automaton.
+ */
+typedef struct {
+    /* The literal character, 0 for a wildcard. */
+    gunichar c;
+    /* Wildcard '*' if true, wildcard '?' or a literal character otherwise. */
+    bool star;
+} FBGlobElement;
+
+/**
+ * Suffixes of one length.
+ */
+typedef struct {
+    /* Length of the suffixes. */
+    unsigned int len;
+    /* Set of the last bytes of the suffixes. */
+    uint64_t last_bytes[4];
+} FBSuffixLength;
+
+struct FBExcludeMatcher {
+    /* Patterns without wildcards. */
+    GHashTable *literals;
+    /* Set of the lengths of the literals, lengths of 63 and above share the last bit. */
+    uint64_t literal_lengths;
+    /* Suffixes of the patterns that are a star followed by a literal. */
+    GHashTable *suffixes;
+    /* Distinct lengths of the suffixes. */
+    GArray *suffix_lengths;
+
+    /* The automaton of all other patterns. Every pattern of n elements has n + 1 states, state i of a pattern is
+     * active if its first i elements match the characters read so far. States are bits of num_words words. */
+    unsigned int num_words;
+    /* Active states before the first character. */
+    uint64_t *start;
+    /* Final states of the patterns. */
+    uint64_t *accept;
+    /* States before '*' elements, which stay active for every character. */
+    uint64_t *star;
+    /* States before '?' elements, which advance for every character. */
+    uint64_t *any;
+    /* States that advance for an ASCII character, num_words words per character. */
+    uint64_t *ascii;
+    /* States that advance for other characters, by character. Characters that are not in the table only advance
+     * the states in any. */
+    GHashTable *chars;
+};
+
+/**
+ * Reads the character at c into *character and returns the next character. Bytes that are not part of a valid UTF-8
+ * character are read as one character each, outside of the Unicode range.
+ */
+static inline const char *read_char ( const char *c, gunichar *character );
+
+/**
+ * Parses a pattern into its elements. Consecutive stars are merged, since they match the same names as one star.
+ */
+static GArray *parse_glob ( const char *glob );
+
+/**
+ * Builds the automaton of the parsed patterns.
+ */
+static void build_automaton ( FBExcludeMatcher *matcher, GPtrArray *globs );
+
+/**
+ * Returns the states mask of a literal character, creating it if necessary.
+ */
+static uint64_t *get_char_mask ( FBExcludeMatcher *matcher, gunichar c );
+
+/**
+ * Runs the automaton on a valid UTF-8 name. Returns true if a pattern matches the whole name.
+ */
+static bool match_automaton ( const FBExcludeMatcher *matcher, const char *name );
+
+/**
+ * Runs an automaton with a single word of states on a valid UTF-8 name.
+ */
+static bool match_automaton_word ( const FBExcludeMatcher *matcher, const char *name );
+
+/**
+ * Activates the states after the active '*' states, since a star also matches no characters.
+ */
+static inline void skip_stars ( const FBExcludeMatcher *matcher, uint64_t *states );
+
+// ================================================================================================================= //
+
+FBExcludeMatcher *exclude_matcher_new ( const char * const *globs )
+{
+    if ( globs == NULL || globs[0] == NULL ) {
+        return NULL;
+    }
+
+    FBExcludeMatcher *matcher = g_malloc0 ( sizeof ( FBExcludeMatcher ) );
+    matcher->literals = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+    matcher->suffixes = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+    matcher->suffix_lengths = g_array_new ( false, false, sizeof ( FBSuffixLength ) );
+
+    GPtrArray *automaton_globs = g_ptr_array_new_with_free_func ( ( GDestroyNotify ) g_array_unref );
+    for ( const char * const *glob = globs; *glob != NULL; glob++ ) {
+        const char *wildcard = strpbrk ( *glob, "*?" );
+        if ( wildcard == NULL ) {
+            g_hash_table_add ( matcher->literals, g_strdup ( *glob ) );
+            matcher->literal_lengths |= ( uint64_t ) 1 << MIN ( strlen ( *glob ), 63 );
+
+        } else if ( wildcard == *glob && *wildcard == '*' && strpbrk ( wildcard + 1, "*?" ) == NULL ) {
+            unsigned int len = strlen ( wildcard + 1 );
+            g_hash_table_add ( matcher->suffixes, g_strdup ( wildcard + 1 ) );
+            FBSuffixLength *suffix_length = NULL;
+            for ( unsigned int i = 0; i < matcher->suffix_lengths->len && suffix_length == NULL; i++ ) {
+                FBSuffixLength *other = &g_array_index ( matcher->suffix_lengths, FBSuffixLength, i );
+                suffix_length = other->len == len ? other : NULL;
+            }
+            if ( suffix_length == NULL ) {
+                FBSuffixLength new_length = { .len = len };
+                g_array_append_val ( matcher->suffix_lengths, new_length );
+                unsigned int index = matcher->suffix_lengths->len - 1;
+                suffix_length = &g_array_index ( matcher->suffix_lengths, FBSuffixLength, index );
+            }
+            unsigned char last = len > 0 ? wildcard[len] : 0;
+            suffix_length->last_bytes[last / 64] |= ( uint64_t ) 1 << ( last % 64 );
+
+        } else {
+            g_ptr_array_add ( automaton_globs, parse_glob ( *glob ) );
+        }
+    }
+
+    build_automaton ( matcher, automaton_globs );
+    g_ptr_array_free ( automaton_globs, true );
+
+    return matcher;
+}
+
+bool exclude_matcher_match ( const FBExcludeMatcher *matcher, const char *basename )
+{
+    if ( matcher == NULL ) {
+        return false;
+    }
+
+    size_t len = strlen ( basename );
+    if ( ( matcher->literal_lengths & ( ( uint64_t ) 1 << MIN ( len, 63 ) ) )
+            && g_hash_table_contains ( matcher->literals, basename ) ) {
+        return true;
+    }
+    /* The hash set is only looked up for suffixes whose last byte is the last byte of the name. */
+    unsigned char last = len > 0 ? basename[len - 1] : 0;
+    for ( unsigned int i = 0; i < matcher->suffix_lengths->len; i++ ) {
+        const FBSuffixLength *suffix_length = &g_array_index ( matcher->suffix_lengths, FBSuffixLength, i );
+        if ( suffix_length->len == 0 ) {
+            return true;
+        } else if ( suffix_length->len <= len
+                && ( suffix_length->last_bytes[last / 64] & ( ( uint64_t ) 1 << ( last % 64 ) ) )
+                && g_hash_table_contains ( matcher->suffixes, &basename[len - suffix_length->len] ) ) {
+            return true;
+        }
+    }
+    return matcher->num_words == 1 ? match_automaton_word ( matcher, basename ) : match_automaton ( matcher, basename );
+}
+
+void exclude_matcher_free ( FBExcludeMatcher *matcher )
+{
+    if ( matcher == NULL ) {
+        return;
+    }
+    g_hash_table_destroy ( matcher->literals );
+    g_hash_table_destroy ( matcher->suffixes );
+    g_array_free ( matcher->suffix_lengths, true );
+    g_free ( matcher->start );
+    g_free ( matcher->accept );
+    g_free ( matcher->star );
+    g_free ( matcher->any );
+    g_free ( matcher->ascii );
+    if ( matcher->chars != NULL ) {
+        g_hash_table_destroy ( matcher->chars );
+    }
+    g_free ( matcher );
+}
+
+static inline const char *read_char ( const char *c, gunichar *character )
+{
+    if ( ( unsigned char ) *c < 0x80 ) {
+        *character = ( unsigned char ) *c;
+        return c + 1;
+    }
+    *character = g_utf8_get_char_validated ( c, -1 );
+    if ( *character == ( gunichar ) -1 || *character == ( gunichar ) -2 ) {
+        *character = 0x110000 + ( unsigned char ) *c;
+        return c + 1;
+    }
+    return g_utf8_next_char ( c );
+}
+
+static GArray *parse_glob ( const char *glob )
+{
+    GArray *elements = g_array_new ( false, false, sizeof ( FBGlobElement ) );
+    for ( const char *c = glob; *c != '\0'; ) {
+        FBGlobElement element;
+        element.star = *c == '*';
+        c = read_char ( c, &element.c );
+        element.c = element.star || element.c == '?' ? 0 : element.c;
+        if ( ! ( element.star && elements->len > 0
+                && g_array_index ( elements, FBGlobElement, elements->len - 1 ).star ) ) {
+            g_array_append_val ( elements, element );
+        }
+    }
+    return elements;
+}
+
+static void build_automaton ( FBExcludeMatcher *matcher, GPtrArray *globs )
+{
+    unsigned int num_states = 0;
+    for ( unsigned int i = 0; i < globs->len; i++ ) {
+        num_states += ( ( GArray * ) g_ptr_array_index ( globs, i ) )->len + 1;
+    }
+    if ( num_states == 0 ) {
+        return;
+    }
+
+    unsigned int num_words = ( num_states + 63 ) / 64;
+    matcher->num_words = num_words;
+    matcher->start = g_malloc0 ( num_words * sizeof ( uint64_t ) );
+    matcher->accept = g_malloc0 ( num_words * sizeof ( uint64_t ) );
+    matcher->star = g_malloc0 ( num_words * sizeof ( uint64_t ) );
+    matcher->any = g_malloc0 ( num_words * sizeof ( uint64_t ) );
+    matcher->chars = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, g_free );
+
+    unsigned int state = 0;
+    for ( unsigned int i = 0; i < globs->len; i++ ) {
+        GArray *elements = g_ptr_array_index ( globs, i );
+        matcher->start[state / 64] |= ( uint64_t ) 1 << ( state % 64 );
+        for ( unsigned int j = 0; j < elements->len; j++, state++ ) {
+            FBGlobElement *element = &g_array_index ( elements, FBGlobElement, j );
+            uint64_t *mask = element->star ? matcher->star : element->c == 0 ? matcher->any
+                : get_char_mask ( matcher, element->c );
+            mask[state / 64] |= ( uint64_t ) 1 << ( state % 64 );
+        }
+        matcher->accept[state / 64] |= ( uint64_t ) 1 << ( state % 64 );
+        state++;
+    }
+    skip_stars ( matcher, matcher->start );
+
+    /* '?' elements advance for every character. */
+    matcher->ascii = g_malloc ( 128 * num_words * sizeof ( uint64_t ) );
+    for ( unsigned int c = 0; c < 128; c++ ) {
+        uint64_t *literal = g_hash_table_lookup ( matcher->chars, GUINT_TO_POINTER ( c ) );
+        for ( unsigned int w = 0; w < num_words; w++ ) {
+            matcher->ascii[c * num_words + w] = matcher->any[w] | ( literal != NULL ? literal[w] : 0 );
+        }
+    }
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init ( &iter, matcher->chars );
+    while ( g_hash_table_iter_next ( &iter, NULL, &value ) ) {
+        uint64_t *mask = value;
+        for ( unsigned int w = 0; w < num_words; w++ ) {
+            mask[w] |= matcher->any[w];
+        }
+    }
+}
+
+static uint64_t *get_char_mask ( FBExcludeMatcher *matcher, gunichar c )
+{
+    uint64_t *mask = g_hash_table_lookup ( matcher->chars, GUINT_TO_POINTER ( c ) );
+    if ( mask == NULL ) {
+        mask = g_malloc0 ( matcher->num_words * sizeof ( uint64_t ) );
+        g_hash_table_insert ( matcher->chars, GUINT_TO_POINTER ( c ), mask );
+    }
+    return mask;
+}
+
+static bool match_automaton ( const FBExcludeMatcher *matcher, const char *name )
+{
+    unsigned int num_words = matcher->num_words;
+    if ( num_words == 0 ) {
+        return false;
+    }
+
+    uint64_t stack_states[STACK_WORDS];
+    uint64_t *states = num_words <= STACK_WORDS ? stack_states : g_malloc ( num_words * sizeof ( uint64_t ) );
+    memcpy ( states, matcher->start, num_words * sizeof ( uint64_t ) );
+
+    bool active = true;
+    for ( const char *c = name; *c != '\0' && active; ) {
+        const uint64_t *mask;
+        if ( ( unsigned char ) *c < 0x80 ) {
+            mask = &matcher->ascii[( unsigned char ) *c * num_words];
+            c++;
+        } else {
+            gunichar character;
+            c = read_char ( c, &character );
+            mask = g_hash_table_lookup ( matcher->chars, GUINT_TO_POINTER ( character ) );
+            mask = mask != NULL ? mask : matcher->any;
+        }
+
+        /* States whose element matches the character advance, states before stars stay. */
+        uint64_t carry = 0;
+        for ( unsigned int w = 0; w < num_words; w++ ) {
+            uint64_t advanced = states[w] & mask[w];
+            states[w] = ( advanced << 1 ) | carry | ( states[w] & matcher->star[w] );
+            carry = advanced >> 63;
+        }
+        skip_stars ( matcher, states );
+
+        active = false;
+        for ( unsigned int w = 0; w < num_words && ! active; w++ ) {
+            active = states[w] != 0;
+        }
+    }
+
+    bool matched = false;
+    for ( unsigned int w = 0; w < num_words && ! matched; w++ ) {
+        matched = ( states[w] & matcher->accept[w] ) != 0;
+    }
+
+    if ( states != stack_states ) {
+        g_free ( states );
+    }
+    return matched;
+}
+
+static bool match_automaton_word ( const FBExcludeMatcher *matcher, const char *name )
+{
+    uint64_t states = matcher->start[0];
+    uint64_t star = matcher->star[0];
+    for ( const char *c = name; *c != '\0' && states != 0; ) {
+        uint64_t mask;
+        if ( ( unsigned char ) *c < 0x80 ) {
+            mask = matcher->ascii[( unsigned char ) *c];
+            c++;
+        } else {
+            gunichar character;
+            c = read_char ( c, &character );
+            const uint64_t *char_mask = g_hash_table_lookup ( matcher->chars, GUINT_TO_POINTER ( character ) );
+            mask = char_mask != NULL ? char_mask[0] : matcher->any[0];
+        }
+        states = ( ( states & mask ) << 1 ) | ( states & star );
+        states |= ( states & star ) << 1;
+    }
+    return ( states & matcher->accept[0] ) != 0;
+}
+
+static inline void skip_stars ( const FBExcludeMatcher *matcher, uint64_t *states )
+{
+    /* Consecutive stars are merged, so the state after a star is never before another star. */
+    uint64_t carry = 0;
+    for ( unsigned int w = 0; w < matcher->num_words; w++ ) {
+        uint64_t stars = states[w] & matcher->star[w];
+        states[w] |= ( stars << 1 ) | carry;
+        carry = stars >> 63;
+    }
+}
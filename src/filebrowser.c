@@ -1,3 +1,5 @@
+#define G_LOG_DOMAIN "FileBrowser"
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <gmodule.h>
@@ -15,6 +17,8 @@
 #include "util.h"
 #include "cmds.h"
 #include "options.h"
+#include "watch.h"
+#include "match.h"
 
 G_MODULE_EXPORT Mode mode;
 
@@ -26,6 +30,35 @@ G_MODULE_EXPORT Mode mode;
  */
 static void open_file ( FBFile *fbfile, char *path, char *cmd, FileBrowserModePrivateData *pd );
 
+/**
+ * Leaves open-custom mode. Sorts the file list if its sorting was postponed while in open-custom mode, and applies
+ * changes of watched directories that were collected while in open-custom mode.
+ */
+static void leave_open_custom ( FileBrowserModePrivateData *pd );
+
+/**
+ * Returns the match keys of the file list, with keys for at least its first num_files files.
+ * Keys are only added on the main thread, while rofi doesn't filter the entries.
+ */
+static FBMatchKeys *get_match_keys ( FileBrowserFileData *fd, unsigned int num_files );
+
+/**
+ * Returns the status bar message, which is only built again when the directory, the hidden state or the truncated
+ * depth has changed.
+ */
+static const char *get_status_message ( FileBrowserModePrivateData *pd );
+
+/**
+ * Counts a string that is allocated for rofi while drawing, if debug messages are enabled, and returns it.
+ * The counts are logged once per frame.
+ */
+static char *count_alloc ( FileBrowserModePrivateData *pd, char *str );
+
+/**
+ * Logs the number of strings that were allocated for rofi in the last frame.
+ */
+static gboolean log_frame_allocs ( gpointer data );
+
 // ================================================================================================================= //
 
 static int file_browser_init ( Mode *sw )
@@ -41,11 +74,12 @@ static int file_browser_init ( Mode *sw )
         if ( ! set_options ( pd ) ) {
             return false;
         }
+        pd->count_allocs = ! g_log_writer_default_would_drop ( G_LOG_LEVEL_DEBUG, G_LOG_DOMAIN );
 
         /* Load the files. */
         FileBrowserFileData *fd = &pd->file_data;
         if ( pd->stdin_mode ) {
-            load_files_from_stdin ( fd );
+            load_files_from_stdin ( fd, pd->stdin_null ? '\0' : '\n' );
         } else {
             load_files ( fd );
         }
@@ -77,6 +111,11 @@ static void file_browser_destroy ( Mode *sw )
     destroy_options ( pd );
 
     /* Free the rest. */
+    if ( pd->frame_allocs_source > 0 ) {
+        g_source_remove ( pd->frame_allocs_source );
+    }
+    g_free ( pd->status_message );
+    g_free ( pd->status_dir );
     g_free ( pd->cmd );
     g_free ( pd->show_hidden_symbol );
     g_free ( pd->hide_hidden_symbol );
@@ -100,7 +139,7 @@ static unsigned int file_browser_get_num_entries ( const Mode *sw )
             return 1;
         }
     } else {
-        return fd->num_files;
+        return get_num_shown_files ( fd );
     }
 }
 
@@ -122,9 +161,8 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
             } else {
                 cmd = ( *input != NULL && strlen ( *input ) == 0 ) ? pd->cmd : *input;
             }
-            open_file ( &fd->files[pd->open_custom_index], NULL, cmd, pd );
-            pd->open_custom = false;
-            pd->open_custom_index = -1;
+            open_file ( get_shown_file ( fd, pd->open_custom_index ), NULL, cmd, pd );
+            leave_open_custom ( pd );
             if ( key != kd->open_multi_key ) {
                 write_resume_file ( pd );
                 retv = MODE_EXIT;
@@ -132,8 +170,7 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
                 retv = RESET_DIALOG;
             }
         } else if ( mretv & MENU_CANCEL ) {
-            pd->open_custom = false;
-            pd->open_custom_index = -1;
+            leave_open_custom ( pd );
             retv = RESET_DIALOG;
         }
 
@@ -141,6 +178,8 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
     } else if ( key == kd->open_custom_key && selected_line != -1 ) {
         pd->open_custom = true;
         pd->open_custom_index = selected_line;
+        /* Files that are listed in the background must not be sorted while open_custom_index is used. */
+        fd->keep_order = true;
         if ( pd->search_path_for_cmds ) {
             search_path_for_cmds ( pd );
             pd->search_path_for_cmds = false;
@@ -149,7 +188,7 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
 
     /* Handle return or open-multi. */
     } else if ( ( mretv & MENU_OK || key == kd->open_multi_key ) && selected_line != -1 ) {
-        FBFile* entry = &fd->files[selected_line];
+        FBFile* entry = get_shown_file ( fd, selected_line );
         switch ( entry->type ) {
         case UP:
         case DIRECTORY:
@@ -161,7 +200,9 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
                     retv = MODE_EXIT;
                 }
             } else {
-                change_dir ( entry->path, fd );
+                char *path = get_file_path ( fd, entry );
+                change_dir ( path, fd );
+                g_free ( path );
                 load_files ( fd );
                 retv = RESET_DIALOG;
             }
@@ -175,13 +216,17 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
                 retv = MODE_EXIT;
             }
             break;
-        case UNKNOWN:
-            if ( g_file_test ( entry->path, G_FILE_TEST_IS_DIR ) ) {
+        case UNKNOWN: {
+            char *path = get_file_path ( fd, entry );
+            bool is_dir = g_file_test ( path, G_FILE_TEST_IS_DIR );
+            g_free ( path );
+            if ( is_dir ) {
                 goto directory;
             } else {
                 goto file;
             }
         }
+        }
 
     /* Handle custom input or Control+Return. */
     } else if ( mretv & MENU_CUSTOM_INPUT ) {
@@ -208,7 +253,21 @@ static ModeMode file_browser_result ( Mode *sw,  int mretv, char **input, unsign
     /* Toggle hidden files with toggle_hidden_key. */
     } else if ( key == kd->toggle_hidden_key ) {
         fd->show_hidden = ! fd->show_hidden;
-        load_files ( fd );
+        /* Hidden files are already listed, unless hidden directories were skipped. */
+        if ( fd->show_hidden && fd->hidden_pruned ) {
+            load_files ( fd );
+        } else {
+            filter_files ( fd );
+        }
+        retv = RELOAD_DIALOG;
+
+    /* Double the budget of a truncated listing with extend_budget_key. */
+    } else if ( key == kd->extend_budget_key ) {
+        if ( fd->truncated_depth > 0 ) {
+            fd->time_budget = MIN ( fd->time_budget, G_MAXUINT / 2 ) * 2;
+            fd->entry_budget = MIN ( fd->entry_budget, G_MAXUINT / 2 ) * 2;
+            load_files ( fd );
+        }
         retv = RELOAD_DIALOG;
 
     /* Default actions */
@@ -234,15 +293,37 @@ static int file_browser_token_match ( const Mode *sw, rofi_int_matcher **tokens,
     if ( pd->open_custom ) {
         if ( pd->show_cmds ) {
             FBCmd *fbcmd = &pd->cmds[index];
-            return helper_token_match ( tokens, fbcmd->name != NULL ? fbcmd->name : fbcmd->cmd );
+            return helper_token_match ( tokens, fbcmd->name );
         } else {
             return true;
         }
     } else {
-        return helper_token_match ( tokens, fd->files[index].name );
+        const FBFile *file = get_shown_file ( fd, index );
+        unsigned int file_index = file - fd->files;
+
+        /* Files that were added after the keys were last updated are matched by their name. */
+        if ( file_index < match_keys_count ( fd->match_keys ) ) {
+            return match_keys_match ( fd->match_keys, file_index, tokens );
+        }
+        char *name = get_file_name ( fd, file );
+        int match = helper_token_match ( tokens, name );
+        g_free ( name );
+        return match;
     }
 }
 
+static char *file_browser_preprocess_input ( Mode *sw, const char *input )
+{
+    FileBrowserModePrivateData *pd = ( FileBrowserModePrivateData * ) mode_get_private_data ( sw );
+    FileBrowserFileData *fd = &pd->file_data;
+
+    /* Called on the main thread before the entries are filtered, except in combi mode, where files without keys are
+     * matched by their names. */
+    get_match_keys ( fd, fd->num_files );
+
+    return g_strdup ( input );
+}
+
 static char *file_browser_get_display_value ( const Mode *sw, unsigned int selected_line, G_GNUC_UNUSED int *state,
         G_GNUC_UNUSED GList **attr_list, int get_entry )
 {
@@ -253,13 +334,12 @@ static char *file_browser_get_display_value ( const Mode *sw, unsigned int selec
 
     if ( pd->open_custom && pd->show_cmds ) {
         *state |= 8;
-        FBCmd *fbcmd = &pd->cmds[selected_line];
-        char* name = fbcmd->name != NULL ? fbcmd->name : fbcmd->cmd;
-        return rofi_force_utf8 ( name, strlen ( name ) );
+        return count_alloc ( pd, g_strdup ( pd->cmds[selected_line].name ) );
     } else {
+        /* Rows are displayed from the keys, which are only built up to the displayed files until text is entered. */
         int index = pd->open_custom ? pd->open_custom_index : selected_line;
-        FBFile *fbfile = &fd->files[index];
-        return rofi_force_utf8 ( fbfile->name, strlen ( fbfile->name ) );
+        unsigned int file_index = get_shown_file ( fd, index ) - fd->files;
+        return count_alloc ( pd, g_strdup ( match_keys_get ( get_match_keys ( fd, file_index + 1 ), file_index ) ) );
     }
 }
 
@@ -283,12 +363,20 @@ static cairo_surface_t *file_browser_get_icon ( const Mode *sw, unsigned int sel
 
     } else {
         int index = pd->open_custom ? pd->open_custom_index : selected_line;
-        FBFile *fbfile = & fd->files[index];
+        FBFile *fbfile = get_shown_file ( fd, index );
 
-        if ( fbfile->icon_fetcher_requests == NULL ) {
-            request_icons_for_file ( fbfile, height, id );
+        /* Icons are only requested for files that are displayed. */
+        if ( fd->icons == NULL ) {
+            fd->icons = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, g_free );
+        }
+        FBIconRequests *requests = g_hash_table_lookup ( fd->icons, fbfile->name );
+        if ( requests == NULL ) {
+            char *path = get_file_path ( fd, fbfile );
+            requests = request_icons_for_file ( fbfile, path, height, id );
+            g_free ( path );
+            g_hash_table_insert ( fd->icons, ( gpointer ) fbfile->name, requests );
         }
-        return fetch_icon_for_file ( fbfile );
+        return fetch_icon_for_file ( requests );
     }
 }
 
@@ -298,21 +386,13 @@ static char *file_browser_get_message ( const Mode *sw )
     FileBrowserFileData *fd = &pd->file_data;
 
     if ( pd->open_custom ) {
-        char* file_name = fd->files[pd->open_custom_index].name;
+        char* file_name = get_file_name ( fd, get_shown_file ( fd, pd->open_custom_index ) );
         char* message = g_strdup_printf ( OPEN_CUSTOM_MESSAGE_FORMAT, file_name );
-        return message;
+        g_free ( file_name );
+        return count_alloc ( pd, message );
 
     } else if ( pd->show_status ) {
-        char** split = g_strsplit ( fd->current_dir, G_DIR_SEPARATOR_S, -1 );
-        char* join = g_strjoinv ( pd->path_sep, split );
-        char* message = g_strconcat ( fd->show_hidden ? pd->show_hidden_symbol : pd->hide_hidden_symbol, join, NULL );
-        char* utf8_message = rofi_force_utf8( message, strlen ( message ) );
-
-        g_strfreev ( split );
-        g_free ( join );
-        g_free ( message );
-
-        return utf8_message;
+        return count_alloc ( pd, g_strdup ( get_status_message ( pd ) ) );
 
     } else {
         return NULL;
@@ -321,22 +401,102 @@ static char *file_browser_get_message ( const Mode *sw )
 
 // ================================================================================================================= //
 
+static FBMatchKeys *get_match_keys ( FileBrowserFileData *fd, unsigned int num_files )
+{
+    if ( fd->match_keys == NULL ) {
+        fd->match_keys = match_keys_new ();
+    }
+    match_keys_update ( fd->match_keys, fd, num_files );
+    return fd->match_keys;
+}
+
+static const char *get_status_message ( FileBrowserModePrivateData *pd )
+{
+    FileBrowserFileData *fd = &pd->file_data;
+
+    if ( pd->status_message != NULL && g_strcmp0 ( pd->status_dir, fd->current_dir ) == 0
+            && pd->status_show_hidden == fd->show_hidden && pd->status_truncated_depth == fd->truncated_depth ) {
+        return pd->status_message;
+    }
+
+    char** split = g_strsplit ( fd->current_dir, G_DIR_SEPARATOR_S, -1 );
+    char* join = g_strjoinv ( pd->path_sep, split );
+    char* truncated = fd->truncated_depth > 0 ? g_strdup_printf ( TRUNCATED_MESSAGE_FORMAT, fd->truncated_depth )
+            : NULL;
+    char* message = g_strconcat ( fd->show_hidden ? pd->show_hidden_symbol : pd->hide_hidden_symbol, join,
+            truncated, NULL );
+
+    g_free ( pd->status_message );
+    g_free ( pd->status_dir );
+    pd->status_message = rofi_force_utf8( message, strlen ( message ) );
+    pd->status_dir = g_strdup ( fd->current_dir );
+    pd->status_show_hidden = fd->show_hidden;
+    pd->status_truncated_depth = fd->truncated_depth;
+
+    g_strfreev ( split );
+    g_free ( join );
+    g_free ( truncated );
+    g_free ( message );
+
+    return pd->status_message;
+}
+
+static char *count_alloc ( FileBrowserModePrivateData *pd, char *str )
+{
+    if ( pd->count_allocs ) {
+        pd->frame_allocs++;
+
+        /* The count is logged after rofi has drawn the frame. */
+        if ( pd->frame_allocs_source == 0 ) {
+            pd->frame_allocs_source = g_idle_add ( log_frame_allocs, pd );
+        }
+    }
+    return str;
+}
+
+static gboolean log_frame_allocs ( gpointer data )
+{
+    FileBrowserModePrivateData *pd = data;
+
+    g_debug ( "Allocated %u strings for the last frame.", pd->frame_allocs );
+    pd->frame_allocs = 0;
+    pd->frame_allocs_source = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+static void leave_open_custom ( FileBrowserModePrivateData *pd )
+{
+    FileBrowserFileData *fd = &pd->file_data;
+
+    pd->open_custom = false;
+    pd->open_custom_index = -1;
+    fd->keep_order = false;
+    if ( fd->unsorted ) {
+        sort_files ( fd );
+    }
+    flush_watch ( fd );
+}
+
 static void open_file ( FBFile* fbfile, char *path, char *cmd, FileBrowserModePrivateData *pd )
 {
     char* current_dir = pd->file_data.current_dir;
 
+    char* file_path = NULL;
     char* used_path;
     if ( fbfile != NULL ) {
         if ( pd->open_parent_as_self && fbfile->type == UP ) {
             used_path = current_dir;
         } else {
-            used_path = fbfile->path;
+            file_path = get_file_path ( &pd->file_data, fbfile );
+            used_path = file_path;
         }
     } else {
         used_path = path;
     }
 
     char *canonical_path = get_canonical_abs_path ( used_path, current_dir );
+    g_free ( file_path );
 
     if ( pd->stdout_mode ) {
         printf( "%s\n", canonical_path );
@@ -381,7 +541,7 @@ Mode mode =
     ._get_message       = file_browser_get_message,
 
     ._get_completion    = NULL,
-    ._preprocess_input  = NULL,
+    ._preprocess_input  = file_browser_preprocess_input,
     .private_data       = NULL,
     .free               = NULL,
 };
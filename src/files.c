@@ -1,22 +1,30 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <gmodule.h>
 #include <glib/gstdio.h>
 
 #include "types.h"
 #include "util.h"
 #include "files.h"
-
-#ifdef HAVE_FTW_ACTIONRETVAL /* glibc */
-#define extended_nftw nftw
-#else
-#include "posix-compat/extended_nftw.h"
-#endif
+#include "names.h"
+#include "walker.h"
+#include "stream.h"
+#include "lru.h"
+#include "watch.h"
+#include "sort.h"
+#include "exclude.h"
+#include "mounts.h"
+#include "match.h"
 
 /**
- * Save file browser data globally so nftw's callback can access it.
+ * Size of the chunks stdin is read in.
  */
-static FileBrowserFileData* global_fd;
+#define STDIN_CHUNK_SIZE ( 1024 * 1024 )
 
 /**
  * Frees the current files and initializes the file list with size 1.
@@ -29,38 +37,22 @@ static void free_files ( FileBrowserFileData *fd );
 static void insert_file ( FBFile *fbfile, FileBrowserFileData *fd );
 
 /**
- * Matches a base name to the specified exclude glob patterns.
+ * Adds a file to the shown files if it is not hidden by show_hidden.
  */
-static bool match_glob_patterns(const char *basename, FileBrowserFileData *fd);
+static void show_file ( FileBrowserFileData *fd, unsigned int index );
 
 /**
- * Function used by nftw to add files to the list recursively.
+ * Returns the depth of the current directory's listing: the depth of the options, limited by the depth limit of the
+ * directory's mount.
  */
-static inline int add_file ( const char *fpath, G_GNUC_UNUSED const struct stat *sb, int typeflag, struct FTW *ftwbuf );
+static int get_mount_depth ( const FileBrowserFileData *fd );
 
 /**
- * Compares files alphabetically.
+ * Inserts the paths of data, separated by separator, into the file list. Empty paths are skipped.
+ * Returns the number of bytes of data that were consumed. Unless eof is set, a path that is not followed by a separator
+ * yet is left over for the next call.
  */
-static gint compare_files ( gconstpointer a, gconstpointer b, gpointer data );
-
-/**
- * Compares files to sort by type (directories first, inaccessible files last).
- * Then compares files alphabetically.
- */
-static gint compare_files_type ( gconstpointer a, gconstpointer b, gpointer data );
-
-/**
- * Compares files to sort by depth.
- * Then compares files alphabetically.
- */
-static gint compare_files_depth ( gconstpointer a, gconstpointer b, gpointer data );
-
-/**
- * Compares files to sort by depth.
- * Then compares files to sort by type (directories first, inaccessible files last).
- * Then compares files alphabetically.
- */
-static gint compare_files_depth_type ( gconstpointer a, gconstpointer b, gpointer data );
+static size_t insert_stdin_files ( FileBrowserFileData *fd, const char *data, size_t len, char separator, bool eof );
 
 /**
  * Directories appear before regular files, inaccessible directories and files appear last.
@@ -71,29 +63,49 @@ static gint compare_files_depth_type ( gconstpointer a, gconstpointer b, gpointe
 
 static void free_files ( FileBrowserFileData *fd )
 {
-    FBFile *files = fd->files;
-    for ( unsigned int i = 0; i < fd->num_files; i++ ) {
-        g_free ( files[i].path );
+    /* The names of all files are freed at once. */
+    arena_reset ( &fd->names );
+    if ( fd->icons != NULL ) {
+        g_hash_table_remove_all ( fd->icons );
     }
     fd->num_files = 0;
     fd->files = g_realloc ( fd->files, sizeof ( FBFile ) );
     fd->size_files = 1;
+    filter_files ( fd );
 }
 
 void destroy_files ( FileBrowserFileData *fd )
 {
+    cancel_stream ( fd );
+    cancel_watch ( fd );
     free_files( fd );
+    if ( fd->lru != NULL ) {
+        lru_free ( fd->lru );
+        fd->lru = NULL;
+    }
     g_free ( fd->current_dir );
     g_free ( fd->files );
+    arena_clear ( &fd->names );
+    if ( fd->icons != NULL ) {
+        g_hash_table_destroy ( fd->icons );
+        fd->icons = NULL;
+    }
+    g_free ( fd->shown );
     g_free ( fd->up_text );
     fd->current_dir = NULL;
     fd->files = NULL;
+    fd->shown = NULL;
     fd->up_text = NULL;
-    for ( int i = 0; i < fd->num_exclude_patterns; i++ ) {
-        g_pattern_spec_free ( fd->exclude_patterns[i] );
-    }
-    g_free ( fd->exclude_patterns );
-    fd->num_exclude_patterns = 0;
+    exclude_matcher_free ( fd->exclude_matcher );
+    g_strfreev ( fd->exclude_globs );
+    g_free ( fd->cache_dir );
+    fd->exclude_globs = NULL;
+    fd->cache_dir = NULL;
+    fd->exclude_matcher = NULL;
+    mount_depths_free ( fd->mount_depths );
+    fd->mount_depths = NULL;
+    match_keys_free ( fd->match_keys );
+    fd->match_keys = NULL;
 }
 
 static void insert_file ( FBFile *fbfile, FileBrowserFileData *fd ) {
@@ -103,241 +115,332 @@ static void insert_file ( FBFile *fbfile, FileBrowserFileData *fd ) {
         fd->files = g_realloc ( fd->files, ( fd->size_files ) * sizeof ( FBFile ) );
     }
     fd->files[fd->num_files] = *fbfile;
+    show_file ( fd, fd->num_files );
     fd->num_files++;
 }
 
-void load_files ( FileBrowserFileData *fd )
+void insert_files ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd )
 {
-    free_files ( fd );
-
-    if ( ! fd->hide_parent ) {
-        /* Insert the parent dir. */
-        FBFile up;
-        up.type = UP;
-        up.name = fd->up_text;
-        up.path = g_build_filename ( fd->current_dir, "..", NULL );
-        up.depth = -1;
-        up.icon_fetcher_requests = NULL;
-        up.num_icon_fetcher_requests = 0;
-        insert_file(&up, fd);
+    /* Increase the array size if needed. */
+    if ( fd->size_files < fd->num_files + num_files ) {
+        fd->size_files = MAX ( fd->size_files * 2, fd->num_files + num_files );
+        fd->files = g_realloc ( fd->files, fd->size_files * sizeof ( FBFile ) );
+    }
+    memcpy ( &fd->files[fd->num_files], files, num_files * sizeof ( FBFile ) );
+    for ( unsigned int i = 0; i < num_files; i++ ) {
+        show_file ( fd, fd->num_files + i );
     }
+    fd->num_files += num_files;
+}
 
-    /* Load the files. */
-    global_fd = fd;
+static void show_file ( FileBrowserFileData *fd, unsigned int index )
+{
+    if ( fd->shown == NULL || fd->files[index].hidden ) {
+        return;
+    }
+    if ( fd->size_shown <= fd->num_shown ) {
+        fd->size_shown = fd->size_shown > 0 ? fd->size_shown * 2 : 64;
+        fd->shown = g_realloc ( fd->shown, fd->size_shown * sizeof ( unsigned int ) );
+    }
+    fd->shown[fd->num_shown++] = index;
+}
 
-    int nftw_flags = fd->follow_symlinks ? FTW_ACTIONRETVAL : ( FTW_ACTIONRETVAL | FTW_PHYS );
-    /* Workaround to make nftw work if the current directory is a symlink. */
-    char *path = g_build_filename ( fd->current_dir, ".", NULL );
-    extended_nftw ( path , add_file, 16, nftw_flags );
-    g_free ( path );
+void filter_files ( FileBrowserFileData *fd )
+{
+    /* The file list may have been reordered. */
+    if ( fd->match_keys != NULL ) {
+        match_keys_reset ( fd->match_keys );
+    }
 
-    /* Exclude the parent dir from sorting. */
-    FBFile *sort_files = fd->files;
-    int num_sort_files = fd->num_files;
-    if ( ! fd->hide_parent ) {
-        sort_files++;
-        num_sort_files--;
+    if ( fd->show_hidden ) {
+        g_free ( fd->shown );
+        fd->shown = NULL;
+        fd->size_shown = 0;
+        fd->num_shown = 0;
+        return;
     }
 
-    /* Sort all but the parent dir. */
-    if ( fd->sort_by_type ) {
-        if ( fd->sort_by_depth ) {
-            g_qsort_with_data ( sort_files, num_sort_files, sizeof ( FBFile ), compare_files_depth_type, NULL );
-        } else {
-            g_qsort_with_data ( sort_files, num_sort_files, sizeof ( FBFile ), compare_files_type, NULL );
-        }
-    } else {
-        if ( fd->sort_by_depth ) {
-            g_qsort_with_data ( sort_files, num_sort_files, sizeof ( FBFile ), compare_files_depth, NULL );
-        } else {
-            g_qsort_with_data ( sort_files, num_sort_files, sizeof ( FBFile ), compare_files, NULL );
-        }
+    if ( fd->shown == NULL ) {
+        fd->size_shown = 64;
+        fd->shown = g_malloc ( fd->size_shown * sizeof ( unsigned int ) );
+    }
+    fd->num_shown = 0;
+    for ( unsigned int i = 0; i < fd->num_files; i++ ) {
+        show_file ( fd, i );
     }
 }
 
-void change_dir ( char *path, FileBrowserFileData *pd )
+unsigned int get_num_shown_files ( const FileBrowserFileData *fd )
 {
-    char* new_dir = get_canonical_abs_path ( path, pd->current_dir );
-    g_free ( pd->current_dir );
-    pd->current_dir = new_dir;
-    g_chdir ( new_dir );
+    return fd->shown != NULL ? fd->num_shown : fd->num_files;
 }
 
-static bool match_glob_patterns ( const char *basename, FileBrowserFileData *fd )
+FBFile *get_shown_file ( const FileBrowserFileData *fd, unsigned int index )
 {
-    int len = strlen ( basename );
-    for ( int i = 0; i < fd->num_exclude_patterns; i++ ) {
-        if ( g_pattern_match ( fd->exclude_patterns[i], len, basename, NULL ) ) {
-            return false;
+    return fd->shown != NULL ? &fd->files[fd->shown[index]] : &fd->files[index];
+}
+
+bool is_hidden_path ( const char *rel_path )
+{
+    return rel_path[0] == '.' || strstr ( rel_path, G_DIR_SEPARATOR_S "." ) != NULL;
+}
+
+bool is_hidden_name ( const FBName *name )
+{
+    for ( ; name != NULL; name = name->parent ) {
+        if ( name->basename[0] == '.' ) {
+            return true;
         }
     }
-    return true;
+    return false;
 }
 
-static int add_file ( const char *fpath, G_GNUC_UNUSED const struct stat *sb, int typeflag, struct FTW *ftwbuf )
+char *get_file_name ( const FileBrowserFileData *fd, const FBFile *file )
 {
-    FileBrowserFileData *fd = global_fd;
-
-    const char *basename = &fpath[ftwbuf->base];
-
-    /* Skip the current dir itself. */
-    if ( ftwbuf->level == 0 ) {
-        return FTW_CONTINUE;
-    /* Skip hidden files. */
-    } else if ( ! fd->show_hidden && basename[0] == '.' ) {
-        return FTW_SKIP_SUBTREE;
-    /* Skip excluded patterns. */
-    } else if ( ! match_glob_patterns ( basename, fd ) ) {
-        return FTW_SKIP_SUBTREE;
+    if ( file->name == NULL ) {
+        return g_strdup ( fd->up_text );
     }
+    char *name = g_malloc ( file->name->len + 1 );
+    write_name ( file->name, name );
+    return name;
+}
 
-    FBFile fbfile;
+char *get_file_path ( const FileBrowserFileData *fd, const FBFile *file )
+{
+    if ( file->name == NULL ) {
+        return g_build_filename ( fd->current_dir, "..", NULL );
+    }
 
-    switch ( typeflag ) {
+    /* Paths given on stdin may be absolute. */
+    char *name = get_file_name ( fd, file );
+    if ( g_path_is_absolute ( name ) ) {
+        return name;
+    }
+    char *path = g_build_filename ( fd->current_dir, name, NULL );
+    g_free ( name );
+    return path;
+}
 
-        /* Regular file. */
-        case FTW_F:
-        file:
-            if ( fd->only_dirs ) {
-                goto skip_file;
-            } else {
-                fbfile.type = RFILE;
-            }
-            break;
+void load_files ( FileBrowserFileData *fd )
+{
+    if ( fd->lru == NULL && fd->lru_memory > 0 ) {
+        fd->lru = lru_new ( ( size_t ) fd->lru_memory * 1024 * 1024 );
+    }
 
-        /* Regular directory. */
-        case FTW_D:
-        directory:
-            if ( fd->only_files ) {
-                goto skip_file;
-            } else {
-                fbfile.type = DIRECTORY;
-            }
-            break;
+    /* Keep the previous listing for when its directory is visited again. */
+    if ( fd->lru != NULL ) {
+        lru_store ( fd->lru, fd );
+    }
+    cancel_stream ( fd );
+    cancel_watch ( fd );
+    free_files ( fd );
+    fd->hidden_pruned = false;
+    fd->truncated_depth = 0;
+
+    /* Listings of network and FUSE mounts can block for a long time and are limited separately. */
+    fd->slow_fs = is_slow_mount ( fd->current_dir );
+    fd->depth = get_mount_depth ( fd );
+
+    if ( fd->lru != NULL ) {
+        if ( lru_restore ( fd->lru, fd ) ) {
+            filter_files ( fd );
+            watch_files ( fd );
+            return;
+        }
+        lru_begin ( fd->lru, fd );
+    }
 
-        /* Inaccessible directory. */
-        case FTW_DNR:
-            fbfile.type = INACCESSIBLE;
-            break;
+    if ( ! fd->hide_parent ) {
+        /* Insert the parent dir. */
+        FBFile up;
+        up.type = UP;
+        up.name = NULL;
+        up.depth = -1;
+        up.hidden = false;
+        insert_file(&up, fd);
+    }
 
-        /* Symbolic link. */
-        case FTW_SL:
-            if ( g_file_test ( fpath, G_FILE_TEST_IS_DIR ) ) {
-                goto directory;
-            } else {
-                goto file;
-            }
-            break;
+    /* In stream mode, the files are loaded and sorted in the background. Slow mounts are always listed in the
+     * background, so rofi stays responsive and the listing can be abandoned. */
+    if ( fd->stream || fd->slow_fs ) {
+        stream_files ( fd );
+        return;
+    }
 
-        /* Symbolic link pointing to nonexistent file. */
-        case FTW_SLN:
-            fbfile.type = INACCESSIBLE;
-            break;
+    /* Only recursive listings profit from multiple threads. */
+    walk_files ( fd, fd->depth != 1 ? fd->num_threads : 1 );
 
-        default:
-            fbfile.type = UNKNOWN;
-            break;
+    sort_files ( fd );
+    watch_files ( fd );
+}
+
+static int get_mount_depth ( const FileBrowserFileData *fd )
+{
+    int limit = mount_depths_get ( fd->mount_depths, fd->current_dir );
+    if ( limit < 0 ) {
+        limit = fd->slow_fs ? ( int ) fd->slow_fs_depth : 0;
     }
 
-    /* Determine the start position of the display name in the path. */
-    int pos = strlen ( fpath ) - 1;
-    int level = ftwbuf->level;
-    while ( level > 0 ) {
-        pos--;
-        if ( fpath[pos] == G_DIR_SEPARATOR ) {
-            level--;
-        }
+    /* 0 means no limit for both depths. */
+    if ( limit == 0 ) {
+        return fd->depth_option;
+    } else if ( fd->depth_option == 0 ) {
+        return limit;
     }
-    pos++;
+    return MIN ( fd->depth_option, limit );
+}
 
-    fbfile.path = g_strdup ( fpath );
-    fbfile.name = &fbfile.path[pos];
-    fbfile.depth = ftwbuf->level;
-    fbfile.icon_fetcher_requests = NULL;
-    fbfile.num_icon_fetcher_requests = 0;
+void sort_files ( FileBrowserFileData *fd )
+{
+    fd->unsorted = false;
 
-    insert_file ( &fbfile, fd );
+    /* Exclude the parent dir from sorting. */
+    FBFile *files = fd->files;
+    int num_files = fd->num_files;
+    if ( ! fd->hide_parent ) {
+        files++;
+        num_files--;
+    }
 
-skip_file:
+    /* Sort all but the parent dir. */
+    sort_file_array ( files, num_files, fd );
 
-    if ( ftwbuf->level >= global_fd->depth && fd->depth != 0 ) {
-        return FTW_SKIP_SUBTREE;
-    } else {
-        return FTW_CONTINUE;
-    }
+    filter_files ( fd );
 }
 
-void load_files_from_stdin ( FileBrowserFileData *fd ) {
-    free_files ( fd );
-    size_t current_dir_len = strlen ( fd->current_dir );
-
-    char *buffer = NULL;
-    size_t len = 0;
-    ssize_t read;
-
-    while ( ( read = getline ( &buffer, &len, stdin ) ) != -1 ) {
-        /* Strip the newline. */
-        buffer[read - 1] = '\0';
-
-        FBFile fbfile;
-        fbfile.type = UNKNOWN;
-        fbfile.depth = 1;
-        fbfile.icon_fetcher_requests = NULL;
-        fbfile.num_icon_fetcher_requests = 0;
-
-        /* If path is absolute. */
-        if ( g_path_is_absolute ( buffer ) ) {
-            fbfile.path = g_strdup ( buffer );
-            fbfile.name = fbfile.path;
+void merge_files ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd )
+{
+    GCompareDataFunc compare = get_compare_func ( fd );
+    sort_file_array ( files, num_files, fd );
+
+    FBFile *merged = g_malloc ( MAX ( fd->num_files + num_files, 1 ) * sizeof ( FBFile ) );
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int n = 0;
+
+    /* The parent dir stays first. */
+    if ( ! fd->hide_parent && fd->num_files > 0 ) {
+        merged[n++] = fd->files[i++];
+    }
+    while ( i < fd->num_files || j < num_files ) {
+        if ( j == num_files || ( i < fd->num_files && compare ( &fd->files[i], &files[j], fd ) <= 0 ) ) {
+            merged[n++] = fd->files[i++];
         } else {
-            fbfile.path = g_strconcat ( fd->current_dir, "/", buffer, NULL );
-            fbfile.name = &fbfile.path[current_dir_len + 1];
+            merged[n++] = files[j++];
         }
+    }
 
-        insert_file ( &fbfile, fd );
+    g_free ( fd->files );
+    fd->files = merged;
+    fd->num_files = n;
+    fd->size_files = MAX ( n, 1 );
+    filter_files ( fd );
+}
+
+void remove_files ( GHashTable *names, FileBrowserFileData *fd )
+{
+    GString *prefix = g_string_new ( NULL );
+    unsigned int n = 0;
+
+    for ( unsigned int i = 0; i < fd->num_files; i++ ) {
+        FBFile *file = &fd->files[i];
+
+        /* Check the file's name and the names of its parent directories below the current directory. */
+        bool removed = false;
+        if ( file->type != UP ) {
+            g_string_set_size ( prefix, file->name->len );
+            write_name ( file->name, prefix->str );
+            while ( ! ( removed = g_hash_table_contains ( names, prefix->str ) ) ) {
+                char *sep = strrchr ( prefix->str, G_DIR_SEPARATOR );
+                if ( sep == NULL ) {
+                    break;
+                }
+                g_string_truncate ( prefix, sep - prefix->str );
+            }
+        }
+
+        /* The names of removed files stay in the arena until the files are loaded again. */
+        if ( ! removed ) {
+            fd->files[n++] = *file;
+        }
     }
+    fd->num_files = n;
 
-    g_free ( buffer );
+    g_string_free ( prefix, true );
+    filter_files ( fd );
 }
 
-static gint compare_files ( gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data )
+void change_dir ( char *path, FileBrowserFileData *pd )
 {
-    const FBFile *fa = a;
-    const FBFile *fb = b;
-    return g_strcmp0 ( fa->name, fb->name );
+    char* new_dir = get_canonical_abs_path ( path, pd->current_dir );
+    g_free ( pd->current_dir );
+    pd->current_dir = new_dir;
+    g_chdir ( new_dir );
 }
 
-static gint compare_files_type ( gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data )
+bool match_glob_patterns ( const char *basename, FileBrowserFileData *fd )
 {
-    const FBFile *fa = a;
-    const FBFile *fb = b;
-    if ( fa->type != fb->type ) {
-        return fa->type - fb->type;
-    } else {
-        return g_strcmp0 ( fa->name, fb->name );
-    }
+    return ! exclude_matcher_match ( fd->exclude_matcher, basename );
 }
 
-static gint compare_files_depth ( gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data )
+void load_files_from_stdin ( FileBrowserFileData *fd, char separator )
 {
-    const FBFile *fa = a;
-    const FBFile *fb = b;
-    if ( fa->depth != fb->depth ) {
-        return fa->depth - fb->depth;
-    } else {
-        return g_strcmp0 ( fa->name, fb->name );
+    free_files ( fd );
+
+    /* Stdin is read in large chunks. The start of a path that continues in the next chunk is moved to the front of the
+     * buffer, and the buffer grows if a single path does not fit into it. */
+    size_t size = STDIN_CHUNK_SIZE;
+    char *buffer = g_malloc ( size );
+    size_t used = 0;
+    while ( true ) {
+        ssize_t num_read = read ( STDIN_FILENO, &buffer[used], size - used );
+        if ( num_read < 0 && errno == EINTR ) {
+            continue;
+        } else if ( num_read < 0 ) {
+            print_err ( "Could not read from stdin: %s\n", g_strerror ( errno ) );
+        }
+        bool eof = num_read <= 0;
+        used += MAX ( num_read, 0 );
+
+        size_t consumed = insert_stdin_files ( fd, buffer, used, separator, eof );
+        if ( eof ) {
+            break;
+        }
+        memmove ( buffer, &buffer[consumed], used - consumed );
+        used -= consumed;
+        if ( used == size ) {
+            size *= 2;
+            buffer = g_realloc ( buffer, size );
+        }
     }
+    g_free ( buffer );
+
+    /* The types are determined in the background, so the paths are shown right away. */
+    stream_types ( fd );
 }
 
-static gint compare_files_depth_type ( gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data )
+static size_t insert_stdin_files ( FileBrowserFileData *fd, const char *data, size_t len, char separator, bool eof )
 {
-    const FBFile *fa = a;
-    const FBFile *fb = b;
-    if ( fa->depth != fb->depth ) {
-        return fa->depth - fb->depth;
-    } else if ( fa->type != fb->type ) {
-        return fa->type - fb->type;
-    } else {
-        return g_strcmp0 ( fa->name, fb->name );
+    FBFile fbfile;
+    fbfile.type = UNKNOWN;
+    fbfile.depth = 1;
+    fbfile.hidden = false;
+
+    size_t pos = 0;
+    while ( pos < len ) {
+        const char *sep = memchr ( &data[pos], separator, len - pos );
+        if ( sep == NULL && ! eof ) {
+            break;
+        }
+        size_t end = sep != NULL ? ( size_t ) ( sep - data ) : len;
+
+        /* The path is displayed as it is given, absolute or relative to the current directory. */
+        if ( end > pos ) {
+            fbfile.name = new_name_len ( &fd->names, NULL, &data[pos], end - pos );
+            insert_file ( &fbfile, fd );
+        }
+        pos = end + 1;
     }
+    return MIN ( pos, len );
 }
+
@@ -13,7 +13,8 @@ void destroy_icon_data ( FileBrowserIconData *id ) {
     g_free ( id->fallback_icon );
 }
 
-void request_icons_for_file ( FBFile *fbfile, int icon_size, FileBrowserIconData *id )
+FBIconRequests *request_icons_for_file ( const FBFile *fbfile, const char *path, int icon_size,
+        FileBrowserIconData *id )
 {
     GArray *icon_names = g_array_new ( false, false, sizeof ( char * ) );
 
@@ -27,11 +28,11 @@ void request_icons_for_file ( FBFile *fbfile, int icon_size, FileBrowserIconData
     } else if ( fbfile->type == INACCESSIBLE ) {
         g_array_append_val( icon_names, id->inaccessible_icon );
 
-    } else if ( fbfile->path == NULL ) {
+    } else if ( path == NULL ) {
         g_array_append_val( icon_names, ERROR_ICON );
 
     } else {
-        file = g_file_new_for_path ( fbfile->path );
+        file = g_file_new_for_path ( path );
         GFileInfo *file_info = g_file_query_info ( file, "standard::icon", G_FILE_QUERY_INFO_NONE, NULL, NULL );
 
         if ( file_info != NULL ) {
@@ -43,8 +44,8 @@ void request_icons_for_file ( FBFile *fbfile, int icon_size, FileBrowserIconData
             }
         }
 
-        if ( id->show_thumbnails && rofi_icon_fetcher_file_is_image( fbfile->path ) ) {
-            g_array_prepend_val ( icon_names, fbfile->path );
+        if ( id->show_thumbnails && rofi_icon_fetcher_file_is_image( path ) ) {
+            g_array_prepend_val ( icon_names, path );
         }
     }
 
@@ -52,10 +53,10 @@ void request_icons_for_file ( FBFile *fbfile, int icon_size, FileBrowserIconData
     char** icon_names_raw = g_array_steal ( icon_names, &num_icon_names );
 
     /* Create icon fetcher requests. */
-    fbfile->num_icon_fetcher_requests = num_icon_names;
-    fbfile->icon_fetcher_requests = malloc ( sizeof ( uint32_t ) * num_icon_names );
+    FBIconRequests *requests = g_malloc ( sizeof ( FBIconRequests ) + sizeof ( uint32_t ) * num_icon_names );
+    requests->num_requests = num_icon_names;
     for ( int i = 0; i < num_icon_names; i++ ) {
-        fbfile->icon_fetcher_requests[i] = rofi_icon_fetcher_query ( icon_names_raw[i], icon_size );
+        requests->requests[i] = rofi_icon_fetcher_query ( icon_names_raw[i], icon_size );
     }
 
     if ( file != NULL ) {
@@ -68,12 +69,14 @@ void request_icons_for_file ( FBFile *fbfile, int icon_size, FileBrowserIconData
         g_free ( icon_path );
     }
     g_array_unref ( icon_names );
+
+    return requests;
 }
 
-cairo_surface_t *fetch_icon_for_file ( FBFile *fbfile )
+cairo_surface_t *fetch_icon_for_file ( const FBIconRequests *requests )
 {
-    for ( int i = 0; i < fbfile->num_icon_fetcher_requests; i++ ) {
-        cairo_surface_t *icon = rofi_icon_fetcher_get ( fbfile->icon_fetcher_requests[i] );
+    for ( int i = 0; i < requests->num_requests; i++ ) {
+        cairo_surface_t *icon = rofi_icon_fetcher_get ( requests->requests[i] );
         if ( icon != NULL ) {
             return icon;
         }
@@ -0,0 +1,398 @@
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#include "ignore.h"
+
+/**
+ * Name of the directory that marks the root of a repository.
+ */
+#define GIT_DIR ".git"
+
+/**
+ * Files ignore rules are loaded from, in increasing precedence.
+ */
+static const char *RULES_FILES[] = { GIT_DIR "/info/exclude", ".gitignore", ".ignore" };
+
+/**
+ * A pattern of an ignore file.
+ */
+typedef struct {
+    /* Offset of the pattern in the patterns of the directory. */
+    unsigned int pattern;
+    /* The pattern starts with '!', files matching it are not ignored. */
+    bool negate;
+    /* The pattern ends with '/', it only matches directories. */
+    bool dir_only;
+    /* The pattern contains a '/', it is matched to the path relative to the directory instead of the basename. */
+    bool anchored;
+} FBIgnoreRule;
+
+struct FBIgnoreDir {
+    /* Rules of the directory above, NULL if there are none. */
+    const FBIgnoreDir *parent;
+    /* Length of the directory's path without a trailing separator. */
+    size_t path_len;
+    /* The NUL-terminated patterns of the rules. */
+    char *patterns;
+    unsigned int num_rules;
+    FBIgnoreRule rules[];
+};
+
+struct FBIgnore {
+    GMutex mutex;
+    /* All loaded directories, freed with the rules. */
+    GPtrArray *dirs;
+};
+
+/**
+ * Reads an ignore file of a directory and appends its rules. Does nothing if the file does not exist.
+ */
+static void read_rules ( int dfd, const char *path, const char *name, GArray *rules, GString *patterns );
+
+/**
+ * Parses one line of an ignore file and appends its rule, unless the line is empty or a comment.
+ */
+static void parse_rule ( const char *line, size_t len, GArray *rules, GString *patterns );
+
+/**
+ * Returns true if the directory contains a .git entry. Sets *is_dir if the entry is a directory.
+ */
+static bool has_git_dir ( int dfd, const char *path, bool *is_dir );
+
+/**
+ * Opens a file in a directory given by an open descriptor, or by its path if dfd is -1.
+ */
+static int open_at ( int dfd, const char *path, const char *name );
+
+/**
+ * Matches a text to a glob pattern. p is the position in the pattern, pattern its start.
+ * Wildcards don't match '/', except for '**' between slashes.
+ */
+static bool match_glob ( const char *pattern, const char *p, const char *t );
+
+/**
+ * Matches a character to the bracket expression at p. Returns the position after the expression, or NULL if the
+ * expression is not terminated.
+ */
+static const char *match_bracket ( const char *p, char c, bool *matched );
+
+// ================================================================================================================= //
+
+FBIgnore *ignore_new ( void )
+{
+    FBIgnore *ignore = g_malloc ( sizeof ( FBIgnore ) );
+    g_mutex_init ( &ignore->mutex );
+    ignore->dirs = g_ptr_array_new ();
+    return ignore;
+}
+
+const FBIgnoreDir *ignore_load_ancestors ( FBIgnore *ignore, const char *path )
+{
+    bool is_dir;
+    if ( has_git_dir ( -1, path, &is_dir ) ) {
+        return NULL;
+    }
+
+    /* Collect the directories above path up to the root of the repository. */
+    GPtrArray *dirs = g_ptr_array_new_with_free_func ( g_free );
+    char *dir = g_strdup ( path );
+    bool found = false;
+    char *sep;
+    while ( ! found && ( sep = strrchr ( dir, G_DIR_SEPARATOR ) ) != NULL ) {
+        *sep = '\0';
+        if ( *( sep + 1 ) == '\0' ) {
+            continue;
+        }
+        g_ptr_array_add ( dirs, g_strdup ( dir ) );
+        found = has_git_dir ( -1, dir, &is_dir );
+    }
+    g_free ( dir );
+
+    const FBIgnoreDir *rules = NULL;
+    for ( unsigned int i = dirs->len; i > 0 && found; i-- ) {
+        rules = ignore_load_dir ( ignore, rules, -1, g_ptr_array_index ( dirs, i - 1 ) );
+    }
+    g_ptr_array_free ( dirs, true );
+    return rules;
+}
+
+const FBIgnoreDir *ignore_load_dir ( FBIgnore *ignore, const FBIgnoreDir *parent, int dfd, const char *path )
+{
+    /* The rules of the directories above a repository don't apply in it. */
+    bool git_is_dir = false;
+    if ( has_git_dir ( dfd, path, &git_is_dir ) ) {
+        parent = NULL;
+    }
+
+    GArray *rules = g_array_new ( false, false, sizeof ( FBIgnoreRule ) );
+    GString *patterns = g_string_new ( NULL );
+    for ( unsigned int i = git_is_dir ? 0 : 1; i < G_N_ELEMENTS ( RULES_FILES ); i++ ) {
+        read_rules ( dfd, path, RULES_FILES[i], rules, patterns );
+    }
+
+    if ( rules->len == 0 ) {
+        g_array_free ( rules, true );
+        g_string_free ( patterns, true );
+        return parent;
+    }
+
+    FBIgnoreDir *dir = g_malloc ( sizeof ( FBIgnoreDir ) + rules->len * sizeof ( FBIgnoreRule ) );
+    dir->parent = parent;
+    dir->path_len = strlen ( path );
+    while ( dir->path_len > 0 && path[dir->path_len - 1] == G_DIR_SEPARATOR ) {
+        dir->path_len--;
+    }
+    dir->num_rules = rules->len;
+    memcpy ( dir->rules, rules->data, rules->len * sizeof ( FBIgnoreRule ) );
+    dir->patterns = g_string_free ( patterns, false );
+    g_array_free ( rules, true );
+
+    g_mutex_lock ( &ignore->mutex );
+    g_ptr_array_add ( ignore->dirs, dir );
+    g_mutex_unlock ( &ignore->mutex );
+    return dir;
+}
+
+bool ignore_match ( const FBIgnoreDir *dir, const char *path, bool is_dir )
+{
+    const char *basename = strrchr ( path, G_DIR_SEPARATOR );
+    basename = basename != NULL ? basename + 1 : path;
+    if ( strcmp ( basename, GIT_DIR ) == 0 ) {
+        return true;
+    }
+
+    /* The last matching rule decides, starting with the rules of the file's own directory. */
+    for ( ; dir != NULL; dir = dir->parent ) {
+        const char *rel_path = &path[dir->path_len + 1];
+        for ( unsigned int i = dir->num_rules; i > 0; i-- ) {
+            const FBIgnoreRule *rule = &dir->rules[i - 1];
+            const char *pattern = &dir->patterns[rule->pattern];
+            if ( ( ! rule->dir_only || is_dir )
+                    && match_glob ( pattern, pattern, rule->anchored ? rel_path : basename ) ) {
+                return ! rule->negate;
+            }
+        }
+    }
+    return false;
+}
+
+bool ignore_is_rules_file ( const char *basename )
+{
+    return strcmp ( basename, ".gitignore" ) == 0 || strcmp ( basename, ".ignore" ) == 0;
+}
+
+void ignore_free ( FBIgnore *ignore )
+{
+    for ( unsigned int i = 0; i < ignore->dirs->len; i++ ) {
+        FBIgnoreDir *dir = g_ptr_array_index ( ignore->dirs, i );
+        g_free ( dir->patterns );
+        g_free ( dir );
+    }
+    g_ptr_array_free ( ignore->dirs, true );
+    g_mutex_clear ( &ignore->mutex );
+    g_free ( ignore );
+}
+
+static void read_rules ( int dfd, const char *path, const char *name, GArray *rules, GString *patterns )
+{
+    int fd = open_at ( dfd, path, name );
+    if ( fd < 0 ) {
+        return;
+    }
+
+    GString *data = g_string_new ( NULL );
+    char buffer[4096];
+    ssize_t len;
+    while ( ( len = read ( fd, buffer, sizeof ( buffer ) ) ) > 0 ) {
+        g_string_append_len ( data, buffer, len );
+    }
+    close ( fd );
+
+    for ( char *line = data->str; line < data->str + data->len; ) {
+        char *end = memchr ( line, '\n', data->str + data->len - line );
+        end = end != NULL ? end : data->str + data->len;
+        parse_rule ( line, end - line, rules, patterns );
+        line = end + 1;
+    }
+    g_string_free ( data, true );
+}
+
+static void parse_rule ( const char *line, size_t len, GArray *rules, GString *patterns )
+{
+    if ( len > 0 && line[len - 1] == '\r' ) {
+        len--;
+    }
+    /* Trailing spaces are removed unless they are escaped. */
+    while ( len > 0 && line[len - 1] == ' ' && ! ( len > 1 && line[len - 2] == '\\' ) ) {
+        len--;
+    }
+    if ( len == 0 || line[0] == '#' ) {
+        return;
+    }
+
+    FBIgnoreRule rule;
+    rule.negate = line[0] == '!';
+    if ( rule.negate ) {
+        line++;
+        len--;
+    }
+    rule.dir_only = len > 0 && line[len - 1] == '/';
+    if ( rule.dir_only ) {
+        len--;
+    }
+    rule.anchored = memchr ( line, '/', len ) != NULL;
+    if ( len > 0 && line[0] == '/' ) {
+        line++;
+        len--;
+    }
+    if ( len == 0 ) {
+        return;
+    }
+
+    rule.pattern = patterns->len;
+    g_string_append_len ( patterns, line, len );
+    g_string_append_c ( patterns, '\0' );
+    g_array_append_val ( rules, rule );
+}
+
+static bool has_git_dir ( int dfd, const char *path, bool *is_dir )
+{
+    struct stat st;
+    bool exists;
+    if ( dfd >= 0 ) {
+        exists = fstatat ( dfd, GIT_DIR, &st, AT_SYMLINK_NOFOLLOW ) == 0;
+    } else {
+        char *git_path = g_build_filename ( path[0] != '\0' ? path : G_DIR_SEPARATOR_S, GIT_DIR, NULL );
+        exists = lstat ( git_path, &st ) == 0;
+        g_free ( git_path );
+    }
+    *is_dir = exists && S_ISDIR ( st.st_mode );
+    return exists;
+}
+
+static int open_at ( int dfd, const char *path, const char *name )
+{
+    if ( dfd >= 0 ) {
+        return openat ( dfd, name, O_RDONLY | O_CLOEXEC );
+    }
+    char *file_path = g_build_filename ( path[0] != '\0' ? path : G_DIR_SEPARATOR_S, name, NULL );
+    int fd = open ( file_path, O_RDONLY | O_CLOEXEC );
+    g_free ( file_path );
+    return fd;
+}
+
+static bool match_glob ( const char *pattern, const char *p, const char *t )
+{
+    while ( *p != '\0' ) {
+        switch ( *p ) {
+            case '*':
+                /* A '**' between slashes matches any number of directories, a trailing one everything below. */
+                if ( p[1] == '*' && ( p == pattern || p[-1] == '/' ) && ( p[2] == '\0' || p[2] == '/' ) ) {
+                    if ( p[2] == '\0' ) {
+                        return true;
+                    }
+                    /* Match the rest of the pattern at the start of the text and after every '/'. */
+                    while ( ! match_glob ( pattern, p + 3, t ) ) {
+                        t = strchr ( t, '/' );
+                        if ( t == NULL ) {
+                            return false;
+                        }
+                        t++;
+                    }
+                    return true;
+                }
+                while ( *p == '*' ) {
+                    p++;
+                }
+                for ( ; ; t++ ) {
+                    if ( match_glob ( pattern, p, t ) ) {
+                        return true;
+                    } else if ( *t == '\0' || *t == '/' ) {
+                        return false;
+                    }
+                }
+
+            case '?':
+                if ( *t == '\0' || *t == '/' ) {
+                    return false;
+                }
+                p++;
+                t++;
+                break;
+
+            case '[': {
+                bool matched;
+                const char *end = match_bracket ( p, *t, &matched );
+                if ( end != NULL ) {
+                    if ( *t == '\0' || *t == '/' || ! matched ) {
+                        return false;
+                    }
+                    p = end;
+                    t++;
+                    break;
+                }
+                /* An unterminated bracket is matched literally. */
+                if ( *t != '[' ) {
+                    return false;
+                }
+                p++;
+                t++;
+                break;
+            }
+
+            case '\\':
+                if ( p[1] != '\0' ) {
+                    p++;
+                }
+                /* fall through */
+            default:
+                if ( *p != *t ) {
+                    return false;
+                }
+                p++;
+                t++;
+                break;
+        }
+    }
+    return *t == '\0';
+}
+
+static const char *match_bracket ( const char *p, char c, bool *matched )
+{
+    p++;
+    bool negate = *p == '!' || *p == '^';
+    if ( negate ) {
+        p++;
+    }
+
+    /* A ']' at the start is part of the expression. */
+    bool found = false;
+    const char *start = p;
+    while ( *p != ']' || p == start ) {
+        if ( *p == '\0' ) {
+            return NULL;
+        }
+        char low = *p;
+        if ( low == '\\' && p[1] != '\0' ) {
+            low = *++p;
+        }
+        char high = low;
+        if ( p[1] == '-' && p[2] != ']' && p[2] != '\0' ) {
+            p += 2;
+            high = *p;
+            if ( high == '\\' && p[1] != '\0' ) {
+                high = *++p;
+            }
+        }
+        unsigned char uc = c;
+        found = found || ( uc >= ( unsigned char ) low && uc <= ( unsigned char ) high );
+        p++;
+    }
+    *matched = found != negate;
+    return p + 1;
+}
@@ -60,23 +60,28 @@ void set_key_bindings (
         char *open_custom_key_str,
         char* open_multi_key_str,
         char* toggle_hidden_key_str,
+        char* extend_budget_key_str,
         FileBrowserKeyData *kd )
 {
     kd->open_custom_key   = OPEN_CUSTOM_KEY;
     kd->open_multi_key    = OPEN_MULTI_KEY;
     kd->toggle_hidden_key = TOGGLE_HIDDEN_KEY;
+    kd->extend_budget_key = EXTEND_BUDGET_KEY;
 
     FBKey *keys[] = { &kd->open_custom_key,
                       &kd->open_multi_key,
-                      &kd->toggle_hidden_key };
+                      &kd->toggle_hidden_key,
+                      &kd->extend_budget_key };
     char *names[] = { "open-custom",
                       "open-multi",
-                      "toggle-hidden" };
+                      "toggle-hidden",
+                      "extend-budget" };
     char *params[] = { open_custom_key_str,
                        open_multi_key_str,
-                       toggle_hidden_key_str };
+                       toggle_hidden_key_str,
+                       extend_budget_key_str };
 
-    for ( int i = 0; i < 3; i++ ) {
+    for ( int i = 0; i < 4; i++ ) {
         if ( params[i] != NULL ) {
             *keys[i] = get_key_for_name ( params[i] );
             if ( *keys[i] == KEY_UNSUPPORTED ) {
@@ -88,9 +93,9 @@ void set_key_bindings (
         }
     }
 
-    for ( int i = 0; i < 3; i++ ) {
+    for ( int i = 0; i < 4; i++ ) {
         if ( *keys[i] != KEY_NONE ) {
-            for ( int j = 0; j < 3; j++ ) {
+            for ( int j = 0; j < 4; j++ ) {
                 if ( i != j && *keys[i] == *keys[j] ) {
                     *keys[j] = KEY_NONE;
                     char *key_name = get_name_of_key ( *keys[i] );
@@ -0,0 +1,222 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#include "types.h"
+#include "lru.h"
+
+/**
+ * State of a directory, a listing is valid as long as its directory's state is unchanged.
+ */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    struct timespec ctime;
+} FBDirState;
+
+/**
+ * A listing in the LRU.
+ */
+typedef struct {
+    /* Directory and options of the listing. */
+    char *key;
+    FBDirState state;
+    FBFile *files;
+    unsigned int num_files;
+    FBArena names;
+    GHashTable *icons;
+    /* Estimated memory used by the listing. */
+    size_t memory;
+} FBLruEntry;
+
+struct FBLru {
+    /* Listings, most recently used first. */
+    GQueue entries;
+    /* Memory used by all listings. */
+    size_t memory;
+    size_t budget;
+    /* Key and state of the current listing, key is NULL if the current listing can't be stored. */
+    char *current_key;
+    FBDirState current_state;
+};
+
+/**
+ * Builds the key of the current directory's listing. Returns NULL if the listing can't be kept in the LRU.
+ */
+static char *get_key ( FileBrowserFileData *fd );
+
+/**
+ * Gets the state of the current directory. Returns false if the directory can't be stat'ed or changed so recently
+ * that further changes might not change its mtime.
+ */
+static bool get_dir_state ( FileBrowserFileData *fd, FBDirState *state );
+
+/**
+ * Drops the least recently used listings until the memory budget is met.
+ */
+static void evict ( FBLru *lru );
+
+static void free_entry ( FBLruEntry *entry );
+
+// ================================================================================================================= //
+
+FBLru *lru_new ( size_t budget )
+{
+    FBLru *lru = g_malloc0 ( sizeof ( FBLru ) );
+    g_queue_init ( &lru->entries );
+    lru->budget = budget;
+    return lru;
+}
+
+void lru_begin ( FBLru *lru, FileBrowserFileData *fd )
+{
+    g_free ( lru->current_key );
+    lru->current_key = get_key ( fd );
+    if ( lru->current_key != NULL && ! get_dir_state ( fd, &lru->current_state ) ) {
+        g_free ( lru->current_key );
+        lru->current_key = NULL;
+    }
+}
+
+void lru_store ( FBLru *lru, FileBrowserFileData *fd )
+{
+    /* Listings that are still loaded in the background or were not sorted yet are incomplete. */
+    if ( lru->current_key == NULL || fd->active_stream != NULL || fd->unsorted ) {
+        return;
+    }
+
+    FBLruEntry *entry = g_malloc ( sizeof ( FBLruEntry ) );
+    entry->key = lru->current_key;
+    entry->state = lru->current_state;
+    entry->files = fd->files;
+    entry->num_files = fd->num_files;
+    entry->names = fd->names;
+    entry->icons = fd->icons;
+    entry->memory = sizeof ( FBLruEntry ) + fd->size_files * sizeof ( FBFile ) + fd->names.size;
+    if ( fd->icons != NULL ) {
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init ( &iter, fd->icons );
+        while ( g_hash_table_iter_next ( &iter, NULL, &value ) ) {
+            const FBIconRequests *requests = value;
+            entry->memory += sizeof ( FBIconRequests ) + requests->num_requests * sizeof ( uint32_t );
+        }
+    }
+    lru->current_key = NULL;
+
+    fd->files = g_malloc ( sizeof ( FBFile ) );
+    fd->size_files = 1;
+    fd->num_files = 0;
+    arena_init ( &fd->names );
+    fd->icons = NULL;
+
+    g_queue_push_head ( &lru->entries, entry );
+    lru->memory += entry->memory;
+    evict ( lru );
+}
+
+bool lru_restore ( FBLru *lru, FileBrowserFileData *fd )
+{
+    char *key = get_key ( fd );
+    if ( key == NULL ) {
+        return false;
+    }
+
+    GList *link = lru->entries.head;
+    while ( link != NULL && strcmp ( ( ( FBLruEntry * ) link->data )->key, key ) != 0 ) {
+        link = link->next;
+    }
+    g_free ( key );
+    if ( link == NULL ) {
+        return false;
+    }
+
+    FBLruEntry *entry = link->data;
+    g_queue_delete_link ( &lru->entries, link );
+    lru->memory -= entry->memory;
+
+    FBDirState state;
+    if ( ! get_dir_state ( fd, &state ) || state.dev != entry->state.dev || state.ino != entry->state.ino
+            || state.mtime.tv_sec != entry->state.mtime.tv_sec || state.mtime.tv_nsec != entry->state.mtime.tv_nsec
+            || state.ctime.tv_sec != entry->state.ctime.tv_sec || state.ctime.tv_nsec != entry->state.ctime.tv_nsec ) {
+        free_entry ( entry );
+        return false;
+    }
+
+    g_free ( fd->files );
+    fd->files = entry->files;
+    fd->num_files = entry->num_files;
+    fd->size_files = entry->num_files;
+    arena_clear ( &fd->names );
+    fd->names = entry->names;
+    if ( fd->icons != NULL ) {
+        g_hash_table_destroy ( fd->icons );
+    }
+    fd->icons = entry->icons;
+
+    /* The restored listing becomes the current one and can be stored again. */
+    g_free ( lru->current_key );
+    lru->current_key = entry->key;
+    lru->current_state = entry->state;
+    g_free ( entry );
+
+    return true;
+}
+
+void lru_free ( FBLru *lru )
+{
+    g_queue_clear_full ( &lru->entries, ( GDestroyNotify ) free_entry );
+    g_free ( lru->current_key );
+    g_free ( lru );
+}
+
+static char *get_key ( FileBrowserFileData *fd )
+{
+    if ( fd->depth != 1 ) {
+        return NULL;
+    }
+    /* Hidden files are always listed, and no other listing option changes during a session. */
+    return g_strdup ( fd->current_dir );
+}
+
+static bool get_dir_state ( FileBrowserFileData *fd, FBDirState *state )
+{
+    struct stat st;
+    if ( stat ( fd->current_dir, &st ) != 0 ) {
+        return false;
+    }
+
+    time_t racy_time = g_get_real_time () / G_USEC_PER_SEC - 1;
+    if ( st.st_mtim.tv_sec >= racy_time || st.st_ctim.tv_sec >= racy_time ) {
+        return false;
+    }
+
+    state->dev = st.st_dev;
+    state->ino = st.st_ino;
+    state->mtime = st.st_mtim;
+    state->ctime = st.st_ctim;
+    return true;
+}
+
+static void evict ( FBLru *lru )
+{
+    while ( lru->memory > lru->budget ) {
+        FBLruEntry *entry = g_queue_pop_tail ( &lru->entries );
+        lru->memory -= entry->memory;
+        free_entry ( entry );
+    }
+}
+
+static void free_entry ( FBLruEntry *entry )
+{
+    arena_clear ( &entry->names );
+    if ( entry->icons != NULL ) {
+        g_hash_table_destroy ( entry->icons );
+    }
+    g_free ( entry->files );
+    g_free ( entry->key );
+    g_free ( entry );
+}
@@ -0,0 +1,656 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <gmodule.h>
+#include <rofi/helper.h>
+
+#include "types.h"
+#include "names.h"
+#include "match.h"
+#include "trigram.h"
+#include "prefilter.h"
+
+/**
+ * Maximum length of a literal token that is matched with a substring search.
+ */
+#define MAX_LITERAL_LEN 256
+
+/**
+ * Characters that g_regex_escape_string escapes, the only characters that are escaped in a literal pattern.
+ */
+#define REGEX_SPECIAL_CHARS "\\|()[]{}^$*+?."
+
+/**
+ * Minimum number of keys to index the trigrams of. Fewer keys are matched faster than their index is built.
+ */
+#define MIN_INDEXED_KEYS 4096
+
+/**
+ * Number of keys the indexer adds to the index at once, the longest a query waits for the index.
+ */
+#define INDEX_BATCH_SIZE 4096
+
+/**
+ * How a token is matched to the keys.
+ */
+typedef enum {
+    /* Only by its regex. */
+    TOKEN_REGEX,
+    /* Its text is searched, like with rofi's normal matching method. */
+    TOKEN_LITERAL,
+    /* Its characters are searched in order, like with rofi's fuzzy matching method. */
+    TOKEN_FUZZY
+} FBTokenKind;
+
+/**
+ * A token of the current query, parsed from its regex once per query.
+ */
+typedef struct {
+    FBTokenKind kind;
+    bool caseless;
+    /* The needle has only ASCII characters. */
+    bool ascii;
+    /* Text of a literal or characters of a fuzzy token, with ASCII letters lowercased for caseless tokens. */
+    char needle[MAX_LITERAL_LEN];
+    /* Pattern, compile flags and invert flag of the token, which later tokens are compared to. */
+    char *pattern;
+    GRegexCompileFlags flags;
+    bool invert;
+} FBQueryToken;
+
+/**
+ * The parsed tokens of a query.
+ */
+typedef struct {
+    FBQueryToken *tokens;
+    unsigned int num_tokens;
+    unsigned int size_tokens;
+} FBQuery;
+
+struct FBMatchKeys {
+    /* Every key followed by its lowercased copy, each NUL-terminated. */
+    char *buffer;
+    size_t len;
+    size_t size;
+    /* Offsets of the keys in buffer, with the end of the last key at index num_keys. */
+    size_t *offsets;
+    /* The key has non-ASCII characters, by index. */
+    uint8_t *non_ascii;
+    unsigned int num_keys;
+    unsigned int size_keys;
+    /* Buffer the names are written into, reused so keys can be added without allocations. */
+    char *name;
+    size_t name_size;
+    /* Signatures of the bytes of the keys, by index. */
+    uint64_t *signatures;
+    /* Indexes of the keys with non-ASCII characters, which caseless tokens can match without their bytes. */
+    unsigned int *non_ascii_keys;
+    unsigned int num_non_ascii_keys;
+    /* rofi normalizes names before matching them (its normalize-match option), so keys with non-ASCII characters are
+     * matched by helper_token_match. */
+    bool normalize;
+
+    /* ---- Trigram index ---- */
+    /* Trigrams of the lowercased copies, added in the background by the indexer. */
+    FBTrigramIndex *trigrams;
+    /* Guards the index and the keys while the indexer runs. Keys are only added with the lock held. */
+    GMutex index_mutex;
+    /* Keys below this index are in the trigram index. */
+    unsigned int num_indexed;
+    /* Thread that adds the keys to the index, NULL if it was never started. */
+    GThread *indexer;
+    /* The indexer adds keys until all keys are indexed, guarded by index_mutex. */
+    bool indexing;
+    /* The indexer stops after its current batch. */
+    gint cancelled;
+    /* Number of threads waiting for index_mutex, which the indexer lets go first. */
+    gint waiting;
+
+    /* ---- Candidates of the current query ---- */
+    GMutex mutex;
+    /* The query the candidates were found for, one of queries, or NULL if the keys changed since. Queries are parsed
+     * into the other slot, since threads that still match the current query may compare their tokens to it. */
+    FBQuery *query;
+    FBQuery queries[2];
+    /* The candidates were narrowed down, otherwise all keys are candidates. */
+    bool narrowed;
+    /* Bitmap of the keys that may match all tokens, by index. */
+    uint64_t *candidates;
+    /* Ids the trigram index narrows down, with room for all keys. */
+    unsigned int *ids;
+};
+
+/**
+ * Writes the text a regex pattern matches to literal if it is a plain literal: if it has no special characters other
+ * than characters escaped by g_regex_escape_string, like the patterns of rofi's normal matching method.
+ * With lower set, ASCII letters are lowercased. Sets ascii if the literal has only ASCII characters.
+ * Returns false if the pattern is not a plain literal or too long.
+ */
+static bool get_literal ( const char *pattern, char *literal, bool lower, bool *ascii );
+
+/**
+ * Writes the characters of a fuzzy pattern to needle if it has the form rofi's fuzzy matching method gives it:
+ * "(a).*?(b).*?(c)" with the characters escaped by g_regex_escape_string.
+ * With lower set, ASCII letters are lowercased. Sets ascii if the characters are all ASCII characters.
+ * Returns false if the pattern is not a fuzzy pattern or too long.
+ */
+static bool get_fuzzy ( const char *pattern, char *needle, bool lower, bool *ascii );
+
+/**
+ * Parses a token of a query.
+ */
+static void parse_token ( const rofi_int_matcher *token, FBQueryToken *query );
+
+/**
+ * Returns true if the bytes of needle occur in haystack in order.
+ */
+static bool is_subsequence ( const char *haystack, const char *needle );
+
+/**
+ * Returns true if the key of a file matches a token, not taking the token's invert flag into account.
+ */
+static bool match_token ( const FBMatchKeys *keys, unsigned int index, const rofi_int_matcher *token,
+        const FBQueryToken *query );
+
+/**
+ * Returns true if query was parsed from the same tokens.
+ */
+static bool is_query ( const FBQuery *query, rofi_int_matcher * const *tokens );
+
+/**
+ * Parses the tokens of a query into query and finds its candidates. Keys that don't contain all trigrams of a literal
+ * token, or all bytes of a literal or fuzzy token, can't match it.
+ */
+static void find_candidates ( FBMatchKeys *keys, FBQuery *query, rofi_int_matcher * const *tokens );
+
+/**
+ * Returns true if rofi normalizes names before matching them. Plugins can't read the option, but with it "e" matches
+ * "é".
+ */
+static bool get_normalize_match ( void );
+
+/**
+ * Returns the lowercased copy of a key.
+ */
+static const char *get_lower ( const FBMatchKeys *keys, unsigned int index );
+
+/**
+ * Adds the keys that are not indexed yet to the trigram index in batches, until all keys are indexed or the indexer
+ * is cancelled.
+ */
+static gpointer index_thread ( gpointer data );
+
+/**
+ * Locks index_mutex before the indexer continues with its next batch.
+ */
+static void lock_index ( FBMatchKeys *keys );
+
+/**
+ * Cancels the indexer and waits for it to stop.
+ */
+static void stop_indexer ( FBMatchKeys *keys );
+
+// ================================================================================================================= //
+
+FBMatchKeys *match_keys_new ( void )
+{
+    FBMatchKeys *keys = g_malloc0 ( sizeof ( FBMatchKeys ) );
+    keys->size_keys = 1;
+    keys->offsets = g_malloc0 ( sizeof ( size_t ) );
+    keys->non_ascii = g_malloc ( 1 );
+    keys->signatures = g_malloc ( sizeof ( uint64_t ) );
+    keys->non_ascii_keys = g_malloc ( sizeof ( unsigned int ) );
+    keys->candidates = g_malloc ( sizeof ( uint64_t ) );
+    keys->ids = g_malloc ( sizeof ( unsigned int ) );
+    keys->normalize = get_normalize_match ();
+    keys->trigrams = trigram_index_new ();
+    g_mutex_init ( &keys->mutex );
+    g_mutex_init ( &keys->index_mutex );
+    return keys;
+}
+
+void match_keys_update ( FBMatchKeys *keys, const FileBrowserFileData *fd, unsigned int num_files )
+{
+    num_files = MIN ( num_files, fd->num_files );
+    if ( keys->num_keys >= num_files ) {
+        return;
+    }
+
+    lock_index ( keys );
+
+    if ( keys->size_keys < num_files + 1 ) {
+        keys->size_keys = MAX ( keys->size_keys * 2, num_files + 1 );
+        keys->offsets = g_realloc ( keys->offsets, keys->size_keys * sizeof ( size_t ) );
+        keys->non_ascii = g_realloc ( keys->non_ascii, keys->size_keys );
+        keys->signatures = g_realloc ( keys->signatures, keys->size_keys * sizeof ( uint64_t ) );
+        keys->non_ascii_keys = g_realloc ( keys->non_ascii_keys, keys->size_keys * sizeof ( unsigned int ) );
+        keys->candidates = g_realloc ( keys->candidates, ( keys->size_keys + 63 ) / 64 * sizeof ( uint64_t ) );
+        keys->ids = g_realloc ( keys->ids, keys->size_keys * sizeof ( unsigned int ) );
+    }
+    g_atomic_pointer_set ( &keys->query, NULL );
+
+    /* Only invalid names are copied again to make them valid. */
+    for ( unsigned int i = keys->num_keys; i < num_files; i++ ) {
+        const FBFile *file = &fd->files[i];
+        const char *raw = fd->up_text;
+        if ( file->name != NULL ) {
+            if ( keys->name_size < file->name->len + 1 ) {
+                keys->name_size = MAX ( keys->name_size * 2, file->name->len + 1 );
+                keys->name = g_realloc ( keys->name, keys->name_size );
+            }
+            write_name ( file->name, keys->name );
+            raw = keys->name;
+        }
+
+        size_t raw_len = strlen ( raw );
+        char *valid = g_utf8_validate ( raw, raw_len, NULL ) ? NULL : rofi_force_utf8 ( raw, raw_len );
+        const char *key = valid != NULL ? valid : raw;
+        size_t len = valid != NULL ? strlen ( valid ) : raw_len;
+
+        if ( keys->size < keys->len + 2 * ( len + 1 ) ) {
+            keys->size = MAX ( keys->size * 2, keys->len + 2 * ( len + 1 ) );
+            keys->buffer = g_realloc ( keys->buffer, keys->size );
+        }
+        char *dst = &keys->buffer[keys->len];
+        memcpy ( dst, key, len + 1 );
+        char *lower = &dst[len + 1];
+        bool non_ascii = false;
+        for ( size_t j = 0; j <= len; j++ ) {
+            lower[j] = g_ascii_tolower ( key[j] );
+            non_ascii |= ( unsigned char ) key[j] >= 0x80;
+        }
+        keys->signatures[i] = prefilter_signature ( key, len );
+        g_free ( valid );
+
+        keys->non_ascii[i] = non_ascii;
+        if ( non_ascii ) {
+            keys->non_ascii_keys[keys->num_non_ascii_keys++] = i;
+        }
+        keys->len += 2 * ( len + 1 );
+        keys->offsets[i + 1] = keys->len;
+    }
+    keys->num_keys = num_files;
+
+    /* The trigrams of large file lists are indexed in the background. */
+    if ( ! keys->indexing && keys->num_keys >= MIN_INDEXED_KEYS ) {
+        if ( keys->indexer != NULL ) {
+            g_thread_join ( keys->indexer );
+        }
+        keys->indexing = true;
+        keys->indexer = g_thread_new ( "fb-index", index_thread, keys );
+    }
+
+    g_mutex_unlock ( &keys->index_mutex );
+}
+
+void match_keys_reset ( FBMatchKeys *keys )
+{
+    stop_indexer ( keys );
+    keys->len = 0;
+    keys->num_keys = 0;
+    keys->num_non_ascii_keys = 0;
+    trigram_index_reset ( keys->trigrams );
+    keys->num_indexed = 0;
+    g_atomic_pointer_set ( &keys->query, NULL );
+}
+
+void match_keys_wait_indexed ( FBMatchKeys *keys )
+{
+    /* The indexer stops once all keys are indexed. */
+    if ( keys->indexer != NULL ) {
+        g_thread_join ( keys->indexer );
+        keys->indexer = NULL;
+    }
+}
+
+unsigned int match_keys_count ( const FBMatchKeys *keys )
+{
+    return keys != NULL ? keys->num_keys : 0;
+}
+
+const char *match_keys_get ( const FBMatchKeys *keys, unsigned int index )
+{
+    return &keys->buffer[keys->offsets[index]];
+}
+
+bool match_keys_match ( FBMatchKeys *keys, unsigned int index, rofi_int_matcher * const *tokens )
+{
+    if ( keys->normalize && keys->non_ascii[index] ) {
+        return helper_token_match ( tokens, match_keys_get ( keys, index ) );
+    }
+
+    /* The candidates are found by the first thread that matches a key of a new query, the other threads wait. rofi
+     * doesn't announce new queries to modes in combi mode, so queries are told apart by their tokens. */
+    FBQuery *query = g_atomic_pointer_get ( &keys->query );
+    if ( ! is_query ( query, tokens ) ) {
+        g_mutex_lock ( &keys->mutex );
+        query = keys->query;
+        if ( ! is_query ( query, tokens ) ) {
+            query = query == &keys->queries[0] ? &keys->queries[1] : &keys->queries[0];
+            find_candidates ( keys, query, tokens );
+            g_atomic_pointer_set ( &keys->query, query );
+        }
+        g_mutex_unlock ( &keys->mutex );
+    }
+    if ( keys->narrowed && ( keys->candidates[index / 64] & ( UINT64_C ( 1 ) << ( index % 64 ) ) ) == 0 ) {
+        return false;
+    }
+
+    for ( int i = 0; tokens != NULL && tokens[i] != NULL; i++ ) {
+        if ( match_token ( keys, index, tokens[i], &query->tokens[i] ) == ( bool ) tokens[i]->invert ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void match_keys_free ( FBMatchKeys *keys )
+{
+    if ( keys == NULL ) {
+        return;
+    }
+    stop_indexer ( keys );
+    g_free ( keys->buffer );
+    g_free ( keys->offsets );
+    g_free ( keys->non_ascii );
+    g_free ( keys->signatures );
+    g_free ( keys->name );
+    g_free ( keys->non_ascii_keys );
+    g_free ( keys->candidates );
+    g_free ( keys->ids );
+    for ( int i = 0; i < 2; i++ ) {
+        for ( unsigned int j = 0; j < keys->queries[i].num_tokens; j++ ) {
+            g_free ( keys->queries[i].tokens[j].pattern );
+        }
+        g_free ( keys->queries[i].tokens );
+    }
+    trigram_index_free ( keys->trigrams );
+    g_mutex_clear ( &keys->mutex );
+    g_mutex_clear ( &keys->index_mutex );
+    g_free ( keys );
+}
+
+static bool match_token ( const FBMatchKeys *keys, unsigned int index, const rofi_int_matcher *token,
+        const FBQueryToken *query )
+{
+    const char *key = &keys->buffer[keys->offsets[index]];
+
+    /* Caseless tokens with non-ASCII characters and caseless misses in keys with non-ASCII characters need the regex,
+     * which folds non-ASCII characters. */
+    if ( query->kind == TOKEN_LITERAL ) {
+        if ( ! query->caseless ) {
+            return strstr ( key, query->needle ) != NULL;
+        } else if ( query->ascii ) {
+            if ( strstr ( get_lower ( keys, index ), query->needle ) != NULL ) {
+                return true;
+            } else if ( ! keys->non_ascii[index] ) {
+                return false;
+            }
+        }
+
+    } else if ( query->kind == TOKEN_FUZZY && ( ! query->caseless || query->ascii ) ) {
+        /* Bytes in order are only sure to be characters in order if they are ASCII characters, and ".*?" doesn't
+         * match newlines. */
+        if ( is_subsequence ( query->caseless ? get_lower ( keys, index ) : key, query->needle ) ) {
+            if ( query->ascii && strchr ( key, '\n' ) == NULL ) {
+                return true;
+            }
+        } else if ( ! query->caseless || ! keys->non_ascii[index] ) {
+            return false;
+        }
+    }
+
+    return g_regex_match ( token->regex, key, 0, NULL );
+}
+
+static bool is_query ( const FBQuery *query, rofi_int_matcher * const *tokens )
+{
+    if ( query == NULL ) {
+        return false;
+    }
+    unsigned int i = 0;
+    for ( ; tokens != NULL && tokens[i] != NULL; i++ ) {
+        if ( i >= query->num_tokens ) {
+            return false;
+        }
+        const FBQueryToken *token = &query->tokens[i];
+        if ( token->invert != ( bool ) tokens[i]->invert
+                || token->flags != g_regex_get_compile_flags ( tokens[i]->regex )
+                || strcmp ( token->pattern, g_regex_get_pattern ( tokens[i]->regex ) ) != 0 ) {
+            return false;
+        }
+    }
+    return i == query->num_tokens;
+}
+
+static void find_candidates ( FBMatchKeys *keys, FBQuery *query, rofi_int_matcher * const *tokens )
+{
+    for ( unsigned int i = 0; i < query->num_tokens; i++ ) {
+        g_free ( query->tokens[i].pattern );
+    }
+    unsigned int num_tokens = 0;
+    while ( tokens != NULL && tokens[num_tokens] != NULL ) {
+        num_tokens++;
+    }
+    if ( query->size_tokens < num_tokens ) {
+        query->size_tokens = num_tokens;
+        query->tokens = g_realloc ( query->tokens, query->size_tokens * sizeof ( FBQueryToken ) );
+    }
+    query->num_tokens = num_tokens;
+
+    lock_index ( keys );
+    bool indexed = false;
+    unsigned int num_ids = 0;
+    uint64_t signature = 0;
+    bool caseless = false;
+
+    for ( unsigned int i = 0; i < num_tokens; i++ ) {
+        FBQueryToken *token = &query->tokens[i];
+        parse_token ( tokens[i], token );
+        token->pattern = g_strdup ( g_regex_get_pattern ( tokens[i]->regex ) );
+        token->flags = g_regex_get_compile_flags ( tokens[i]->regex );
+        token->invert = tokens[i]->invert;
+
+        /* Caseless tokens with non-ASCII characters can match other bytes. */
+        if ( tokens[i]->invert || token->kind == TOKEN_REGEX || ( token->caseless && ! token->ascii ) ) {
+            continue;
+        }
+        signature |= prefilter_signature ( token->needle, strlen ( token->needle ) );
+        caseless |= token->caseless;
+
+        /* Case-sensitive literals are also searched in the lowercased copies, which finds a superset of their keys. */
+        if ( token->kind == TOKEN_LITERAL ) {
+            char lower[MAX_LITERAL_LEN];
+            size_t j = 0;
+            do {
+                lower[j] = g_ascii_tolower ( token->needle[j] );
+            } while ( token->needle[j++] != '\0' );
+            indexed |= trigram_index_narrow ( keys->trigrams, lower, keys->ids, &num_ids, indexed );
+        }
+    }
+
+    keys->narrowed = indexed || signature != 0;
+    if ( indexed ) {
+        memset ( keys->candidates, 0, ( keys->num_keys + 63 ) / 64 * sizeof ( uint64_t ) );
+        for ( unsigned int i = 0; i < num_ids; i++ ) {
+            keys->candidates[keys->ids[i] / 64] |= UINT64_C ( 1 ) << ( keys->ids[i] % 64 );
+        }
+
+        /* Keys that are not indexed yet are always candidates. */
+        for ( unsigned int i = keys->num_indexed; i < keys->num_keys; i++ ) {
+            keys->candidates[i / 64] |= UINT64_C ( 1 ) << ( i % 64 );
+        }
+    } else if ( keys->narrowed ) {
+        memset ( keys->candidates, 0xff, ( keys->num_keys + 63 ) / 64 * sizeof ( uint64_t ) );
+    }
+    g_mutex_unlock ( &keys->index_mutex );
+
+    if ( signature != 0 ) {
+        prefilter_match ( keys->signatures, keys->num_keys, signature, keys->candidates );
+    }
+    if ( keys->narrowed && caseless ) {
+        for ( unsigned int i = 0; i < keys->num_non_ascii_keys; i++ ) {
+            unsigned int index = keys->non_ascii_keys[i];
+            keys->candidates[index / 64] |= UINT64_C ( 1 ) << ( index % 64 );
+        }
+    }
+}
+
+static const char *get_lower ( const FBMatchKeys *keys, unsigned int index )
+{
+    /* The lowercased copy follows the key, which is half of the key's space. */
+    return &keys->buffer[( keys->offsets[index] + keys->offsets[index + 1] ) / 2];
+}
+
+static gpointer index_thread ( gpointer data )
+{
+    FBMatchKeys *keys = data;
+
+    g_mutex_lock ( &keys->index_mutex );
+    while ( keys->num_indexed < keys->num_keys && ! g_atomic_int_get ( &keys->cancelled ) ) {
+        unsigned int end = MIN ( keys->num_indexed + INDEX_BATCH_SIZE, keys->num_keys );
+        for ( unsigned int i = keys->num_indexed; i < end; i++ ) {
+            size_t len = ( keys->offsets[i + 1] - keys->offsets[i] ) / 2 - 1;
+            trigram_index_add ( keys->trigrams, i, get_lower ( keys, i ), len );
+        }
+        keys->num_indexed = end;
+
+        /* Queries and new keys take the lock between batches. */
+        if ( g_atomic_int_get ( &keys->waiting ) > 0 ) {
+            g_mutex_unlock ( &keys->index_mutex );
+            while ( g_atomic_int_get ( &keys->waiting ) > 0 ) {
+                g_thread_yield ();
+            }
+            g_mutex_lock ( &keys->index_mutex );
+        }
+    }
+    keys->indexing = false;
+    g_mutex_unlock ( &keys->index_mutex );
+
+    return NULL;
+}
+
+static void lock_index ( FBMatchKeys *keys )
+{
+    g_atomic_int_inc ( &keys->waiting );
+    g_mutex_lock ( &keys->index_mutex );
+    g_atomic_int_add ( &keys->waiting, -1 );
+}
+
+static void stop_indexer ( FBMatchKeys *keys )
+{
+    if ( keys->indexer == NULL ) {
+        return;
+    }
+    g_atomic_int_set ( &keys->cancelled, true );
+    g_thread_join ( keys->indexer );
+    keys->indexer = NULL;
+    keys->indexing = false;
+    g_atomic_int_set ( &keys->cancelled, false );
+}
+
+static void parse_token ( const rofi_int_matcher *token, FBQueryToken *query )
+{
+    query->kind = TOKEN_REGEX;
+
+    /* Anchored and extended patterns don't match their text literally. */
+    GRegexCompileFlags flags = g_regex_get_compile_flags ( token->regex );
+    if ( ( flags & ( G_REGEX_ANCHORED | G_REGEX_EXTENDED ) ) != 0 ) {
+        return;
+    }
+
+    const char *pattern = g_regex_get_pattern ( token->regex );
+    query->caseless = ( flags & G_REGEX_CASELESS ) != 0;
+    if ( get_literal ( pattern, query->needle, query->caseless, &query->ascii ) ) {
+        query->kind = TOKEN_LITERAL;
+    } else if ( get_fuzzy ( pattern, query->needle, query->caseless, &query->ascii ) ) {
+        query->kind = TOKEN_FUZZY;
+    }
+}
+
+static bool is_subsequence ( const char *haystack, const char *needle )
+{
+    for ( ; *needle != '\0'; needle++ ) {
+        haystack = strchr ( haystack, *needle );
+        if ( haystack == NULL ) {
+            return false;
+        }
+        haystack++;
+    }
+    return true;
+}
+
+static bool get_fuzzy ( const char *pattern, char *needle, bool lower, bool *ascii )
+{
+    *ascii = true;
+    size_t len = 0;
+    for ( const char *c = pattern; *c != '\0'; ) {
+        if ( len > 0 ) {
+            if ( strncmp ( c, ".*?", 3 ) != 0 ) {
+                return false;
+            }
+            c += 3;
+        }
+        if ( *c != '(' ) {
+            return false;
+        }
+        c++;
+
+        /* One character, which is either escaped or not special. */
+        const char *end;
+        if ( *c == '\\' ) {
+            c++;
+            if ( *c == '\0' || strchr ( REGEX_SPECIAL_CHARS, *c ) == NULL ) {
+                return false;
+            }
+            end = c + 1;
+        } else if ( *c == '\0' || strchr ( REGEX_SPECIAL_CHARS, *c ) != NULL ) {
+            return false;
+        } else {
+            end = g_utf8_next_char ( c );
+        }
+        if ( *end != ')' || len + ( end - c ) >= MAX_LITERAL_LEN ) {
+            return false;
+        }
+        for ( ; c < end; c++ ) {
+            *ascii &= ( unsigned char ) *c < 0x80;
+            needle[len++] = lower ? g_ascii_tolower ( *c ) : *c;
+        }
+        c++;
+    }
+    needle[len] = '\0';
+    return len > 0;
+}
+
+static bool get_literal ( const char *pattern, char *literal, bool lower, bool *ascii )
+{
+    *ascii = true;
+    size_t len = 0;
+    for ( const char *c = pattern; *c != '\0'; c++ ) {
+        if ( *c == '\\' ) {
+            c++;
+            if ( *c == '\0' || strchr ( REGEX_SPECIAL_CHARS, *c ) == NULL ) {
+                return false;
+            }
+        } else if ( strchr ( REGEX_SPECIAL_CHARS, *c ) != NULL ) {
+            return false;
+        }
+
+        if ( len + 1 >= MAX_LITERAL_LEN ) {
+            return false;
+        }
+        *ascii &= ( unsigned char ) *c < 0x80;
+        literal[len++] = lower ? g_ascii_tolower ( *c ) : *c;
+    }
+    literal[len] = '\0';
+    return true;
+}
+
+static bool get_normalize_match ( void )
+{
+    rofi_int_matcher token = { .regex = g_regex_new ( "e", 0, 0, NULL ), .invert = false };
+    rofi_int_matcher *tokens[] = { &token, NULL };
+    bool normalize = helper_token_match ( tokens, "\xc3\xa9" );
+    g_regex_unref ( token.regex );
+    return normalize;
+}
@@ -0,0 +1,152 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <gmodule.h>
+#include <rofi/helper.h>
+
+#ifdef HAVE_STATFS
+#include <sys/vfs.h>
+#endif
+
+#include "util.h"
+#include "mounts.h"
+
+typedef struct FBMountDepth {
+    /* Canonical absolute path without a trailing '/', empty for the root directory. */
+    char *path;
+    size_t len;
+    /* Depth limit, 0 means no limit. */
+    int depth;
+} FBMountDepth;
+
+struct FBMountDepths {
+    /* Sorted by descending path length, so the first matching limit is the one of the longest path. */
+    FBMountDepth *limits;
+    unsigned int num_limits;
+};
+
+/**
+ * File system magic numbers of network and FUSE file systems, as reported by statfs.
+ */
+static const unsigned long SLOW_FS_MAGICS[] = {
+    0x6969,     /* NFS */
+    0x517b,     /* SMB */
+    0xfe534d42, /* SMB2 */
+    0xff534d42, /* CIFS */
+    0x65735546, /* FUSE (sshfs, rclone, ...) */
+    0x00c36400, /* Ceph */
+    0x01021997, /* 9P */
+    0x5346414f, /* AFS */
+    0x6b414653, /* kAFS */
+    0x73757245, /* Coda */
+    0x564c,     /* NCP */
+    0x47504653, /* GPFS */
+    0x0bd00bd0, /* Lustre */
+};
+
+/**
+ * Compares mount depth limits by descending path length.
+ */
+static int compare_mount_depths ( const void *a, const void *b );
+
+// ================================================================================================================= //
+
+FBMountDepths *mount_depths_new ( const char * const *specs )
+{
+    GArray *limits = g_array_new ( false, false, sizeof ( FBMountDepth ) );
+
+    for ( const char * const *spec = specs; spec != NULL && *spec != NULL; spec++ ) {
+        /* The depth follows the last ':', so paths can contain ':'. */
+        const char *sep = strrchr ( *spec, ':' );
+        char *end = NULL;
+        errno = 0;
+        long depth = sep != NULL ? strtol ( sep + 1, &end, 10 ) : -1;
+        if ( sep == NULL || sep == *spec || end == sep + 1 || *end != '\0' || errno != 0 || depth < 0
+                || depth > G_MAXINT ) {
+            print_err ( "Invalid mount depth \"%s\", expected \"<path>:<depth>\" with a non-negative depth.\n", *spec );
+            continue;
+        }
+
+        char *raw_path = g_strndup ( *spec, sep - *spec );
+        char *expanded_path = rofi_expand_path ( raw_path );
+        char *current_dir = g_get_current_dir ();
+        char *path = get_canonical_abs_path ( expanded_path, current_dir );
+        g_free ( current_dir );
+        g_free ( expanded_path );
+        g_free ( raw_path );
+
+        FBMountDepth limit;
+        limit.len = strlen ( path );
+        if ( limit.len > 0 && path[limit.len - 1] == '/' ) {
+            path[--limit.len] = '\0';
+        }
+        limit.path = path;
+        limit.depth = depth;
+        g_array_append_val ( limits, limit );
+    }
+
+    if ( limits->len == 0 ) {
+        g_array_free ( limits, true );
+        return NULL;
+    }
+    g_array_sort ( limits, compare_mount_depths );
+
+    FBMountDepths *depths = g_malloc ( sizeof ( FBMountDepths ) );
+    depths->num_limits = limits->len;
+    depths->limits = ( FBMountDepth * ) g_array_free ( limits, false );
+    return depths;
+}
+
+int mount_depths_get ( const FBMountDepths *depths, const char *path )
+{
+    if ( depths == NULL ) {
+        return -1;
+    }
+    for ( unsigned int i = 0; i < depths->num_limits; i++ ) {
+        const FBMountDepth *limit = &depths->limits[i];
+        /* "/mnt/a" applies to "/mnt/a" and "/mnt/a/b", but not to "/mnt/ab". */
+        if ( strncmp ( path, limit->path, limit->len ) == 0
+                && ( path[limit->len] == '\0' || path[limit->len] == '/' ) ) {
+            return limit->depth;
+        }
+    }
+    return -1;
+}
+
+void mount_depths_free ( FBMountDepths *depths )
+{
+    if ( depths == NULL ) {
+        return;
+    }
+    for ( unsigned int i = 0; i < depths->num_limits; i++ ) {
+        g_free ( depths->limits[i].path );
+    }
+    g_free ( depths->limits );
+    g_free ( depths );
+}
+
+bool is_slow_mount ( G_GNUC_UNUSED const char *path )
+{
+#ifdef HAVE_STATFS
+    struct statfs st;
+    if ( statfs ( path, &st ) != 0 ) {
+        return false;
+    }
+    /* f_type is signed on some architectures, the magic numbers are 32 bits. */
+    unsigned long magic = ( unsigned long ) st.f_type & 0xffffffffUL;
+    for ( size_t i = 0; i < G_N_ELEMENTS ( SLOW_FS_MAGICS ); i++ ) {
+        if ( magic == SLOW_FS_MAGICS[i] ) {
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+static int compare_mount_depths ( const void *a, const void *b )
+{
+    size_t len_a = ( ( const FBMountDepth * ) a )->len;
+    size_t len_b = ( ( const FBMountDepth * ) b )->len;
+    return len_a > len_b ? -1 : len_a < len_b;
+}
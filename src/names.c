@@ -0,0 +1,34 @@
+#include <string.h>
+#include <gmodule.h>
+
+#include "types.h"
+#include "names.h"
+
+const FBName *new_name ( FBArena *arena, const FBName *parent, const char *basename )
+{
+    return new_name_len ( arena, parent, basename, strlen ( basename ) );
+}
+
+const FBName *new_name_len ( FBArena *arena, const FBName *parent, const char *basename, size_t len )
+{
+    FBName *name = arena_alloc ( arena, sizeof ( FBName ) + len + 1 );
+    name->parent = parent;
+    name->collate_key = NULL;
+    name->len = parent != NULL ? parent->len + 1 + len : len;
+    memcpy ( name->basename, basename, len );
+    name->basename[len] = '\0';
+    return name;
+}
+
+void write_name ( const FBName *name, char *buffer )
+{
+    /* Names are written from the end, the parent directories' names precede the basename. */
+    buffer[name->len] = '\0';
+    for ( ; name != NULL; name = name->parent ) {
+        size_t len = name->parent != NULL ? name->len - name->parent->len - 1 : name->len;
+        memcpy ( &buffer[name->len - len], name->basename, len );
+        if ( name->parent != NULL ) {
+            buffer[name->len - len - 1] = G_DIR_SEPARATOR;
+        }
+    }
+}
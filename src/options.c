@@ -11,6 +11,8 @@
 #include "options.h"
 #include "keys.h"
 #include "cmds.h"
+#include "exclude.h"
+#include "mounts.h"
 
 /**
  * Read the config file at the given path and store it into the private data.
@@ -94,10 +96,15 @@ bool set_options ( FileBrowserModePrivateData *pd )
     fd->only_dirs            = fb_find_arg ( "-file-browser-only-dirs"           , pd ) ? true  : ONLY_DIRS;
     fd->only_files           = fb_find_arg ( "-file-browser-only-files"          , pd ) ? true  : ONLY_FILES;
     fd->hide_parent          = fb_find_arg ( "-file-browser-hide-parent"         , pd ) ? true  : HIDE_PARENT;
+    fd->stream               = fb_find_arg ( "-file-browser-stream"              , pd ) ? true  : STREAM;
+    fd->use_cache            = fb_find_arg ( "-file-browser-cache"               , pd ) ? true  : USE_CACHE;
+    fd->use_ignore_files     = fb_find_arg ( "-file-browser-ignore-files"        , pd ) ? true  : USE_IGNORE_FILES;
+    fd->watch                = fb_find_arg ( "-file-browser-watch"               , pd ) ? true  : WATCH;
     id->show_icons           = fb_find_arg ( "-file-browser-disable-icons"       , pd ) ? false : SHOW_ICONS;
     id->show_thumbnails      = fb_find_arg ( "-file-browser-disable-thumbnails"  , pd ) ? false : SHOW_THUMBNAILS;
     pd->stdout_mode          = fb_find_arg ( "-file-browser-stdout"              , pd ) ? true  : STDOUT_MODE;
     pd->stdin_mode           = fb_find_arg ( "-file-browser-stdin"               , pd ) ? true  : STDIN_MODE;
+    pd->stdin_null           = fb_find_arg ( "-file-browser-stdin-null"          , pd ) ? true  : STDIN_NULL;
     pd->show_status          = fb_find_arg ( "-file-browser-disable-status"      , pd ) ? false : SHOW_STATUS;
     pd->no_descend           = fb_find_arg ( "-file-browser-no-descend"          , pd ) ? true  : NO_DESCEND;
     pd->open_parent_as_self  = fb_find_arg ( "-file-browser-open-parent-as-self" , pd ) ? true  : OPEN_PARENT_AS_SELF;
@@ -113,8 +120,62 @@ bool set_options ( FileBrowserModePrivateData *pd )
     pd->hide_hidden_symbol  = str_arg_or_default ( "-file-browser-hide-hidden-symbol", HIDE_HIDDEN_SYMBOL, pd );
     pd->path_sep            = str_arg_or_default ( "-file-browser-path-sep",           PATH_SEP,           pd );
     pd->resume_file         = str_arg_or_default ( "-file-browser-resume-file",        RESUME_FILE,        pd );
+    fd->cache_dir           = str_arg_or_default ( "-file-browser-cache-dir",          CACHE_DIR,          pd );
 
-    fd->depth = int_arg_or_default ( "-file-browser-depth", DEPTH, pd );
+    fd->depth_option = int_arg_or_default ( "-file-browser-depth", DEPTH, pd );
+    fd->depth = fd->depth_option;
+
+    int slow_fs_depth = int_arg_or_default ( "-file-browser-slow-fs-depth", SLOW_FS_DEPTH, pd );
+    if ( slow_fs_depth < 0 ) {
+        print_err ( "Depth on slow file systems must not be negative, got %d. Using %d.\n", slow_fs_depth,
+                SLOW_FS_DEPTH );
+        slow_fs_depth = SLOW_FS_DEPTH;
+    }
+    fd->slow_fs_depth = slow_fs_depth;
+
+    int num_threads = int_arg_or_default ( "-file-browser-threads", THREADS, pd );
+    if ( num_threads < 0 ) {
+        print_err ( "Number of threads must not be negative, got %d. Using %d.\n", num_threads, THREADS );
+        num_threads = THREADS;
+    }
+    fd->num_threads = num_threads;
+
+    int hidden_budget = int_arg_or_default ( "-file-browser-hidden-budget", HIDDEN_BUDGET, pd );
+    if ( hidden_budget < 0 ) {
+        print_err ( "Hidden budget must not be negative, got %d. Using %d.\n", hidden_budget, HIDDEN_BUDGET );
+        hidden_budget = HIDDEN_BUDGET;
+    }
+    fd->hidden_budget = hidden_budget;
+
+    int time_budget = int_arg_or_default ( "-file-browser-time-budget", TIME_BUDGET, pd );
+    if ( time_budget < 0 ) {
+        print_err ( "Time budget must not be negative, got %d. Using %d.\n", time_budget, TIME_BUDGET );
+        time_budget = TIME_BUDGET;
+    }
+    fd->time_budget = time_budget;
+
+    int entry_budget = int_arg_or_default ( "-file-browser-entry-budget", ENTRY_BUDGET, pd );
+    if ( entry_budget < 0 ) {
+        print_err ( "Entry budget must not be negative, got %d. Using %d.\n", entry_budget, ENTRY_BUDGET );
+        entry_budget = ENTRY_BUDGET;
+    }
+    fd->entry_budget = entry_budget;
+
+    int lru_memory = int_arg_or_default ( "-file-browser-lru-memory", LRU_MEMORY, pd );
+    if ( lru_memory < 0 ) {
+        print_err ( "Memory for recently visited listings must not be negative, got %d. Using %d.\n", lru_memory,
+                LRU_MEMORY );
+        lru_memory = LRU_MEMORY;
+    }
+    fd->lru_memory = lru_memory;
+
+    int watch_limit = int_arg_or_default ( "-file-browser-watch-limit", WATCH_LIMIT, pd );
+    if ( watch_limit < 0 ) {
+        print_err ( "Maximum number of watched directories must not be negative, got %d. Using %d.\n", watch_limit,
+                WATCH_LIMIT );
+        watch_limit = WATCH_LIMIT;
+    }
+    fd->watch_limit = watch_limit;
 
     /* Sort options. */
     /* TODO: make a helper function for "no-..." options and add a "no-..." option for all boolean options. */
@@ -132,6 +193,13 @@ bool set_options ( FileBrowserModePrivateData *pd )
     } else {
         fd->sort_by_depth = SORT_BY_DEPTH;
     }
+    if ( fb_find_arg ( "-file-browser-sort-natural", pd ) ) {
+        fd->sort_natural = true;
+    } else if ( fb_find_arg ( "-file-browser-no-sort-natural", pd ) ) {
+        fd->sort_natural = false;
+    } else {
+        fd->sort_natural = SORT_NATURAL;
+    }
 
     /* Start directory. */
     fd->current_dir = get_start_dir( pd );
@@ -141,16 +209,13 @@ bool set_options ( FileBrowserModePrivateData *pd )
 
     /* Set glob patterns. */
     char **exclude_globs_strs = fb_find_arg_strv ( "-file-browser-exclude", pd );
-    if ( exclude_globs_strs == NULL ) {
-        fd->num_exclude_patterns = 0;
-    } else {
-        int num_globs = count_strv ( ( const char ** ) exclude_globs_strs );
-        fd->num_exclude_patterns = num_globs;
-        fd->exclude_patterns = g_malloc ( num_globs * sizeof ( GPatternSpec* ) );
-        for ( int i = 0; i < num_globs; i++ ) {
-            fd->exclude_patterns[i] = g_pattern_spec_new ( exclude_globs_strs[i] );
-        }
-    }
+    fd->exclude_globs = exclude_globs_strs;
+    fd->exclude_matcher = exclude_matcher_new ( ( const char * const * ) exclude_globs_strs );
+
+    /* Set depth limits of mounts. */
+    char **mount_depths_strs = fb_find_arg_strv ( "-file-browser-mount-depth", pd );
+    fd->mount_depths = mount_depths_new ( ( const char * const * ) mount_depths_strs );
+    g_strfreev ( mount_depths_strs );
 
     /* Set commands for open-custom. */
     char ** cmds = fb_find_arg_strv ( "-file-browser-oc-cmd", pd );
@@ -161,10 +226,13 @@ bool set_options ( FileBrowserModePrivateData *pd )
     char *open_custom_key_str =   str_arg_or_default ( "-file-browser-open-custom-key",   NULL, pd );
     char *open_multi_key_str =    str_arg_or_default ( "-file-browser-open-multi-key",    NULL, pd );
     char *toggle_hidden_key_str = str_arg_or_default ( "-file-browser-toggle-hidden-key", NULL, pd );
-    set_key_bindings ( open_custom_key_str, open_multi_key_str, toggle_hidden_key_str, &pd->key_data );
+    char *extend_budget_key_str = str_arg_or_default ( "-file-browser-extend-budget-key", NULL, pd );
+    set_key_bindings ( open_custom_key_str, open_multi_key_str, toggle_hidden_key_str, extend_budget_key_str,
+            &pd->key_data );
     g_free ( open_custom_key_str );
     g_free ( open_multi_key_str );
     g_free ( toggle_hidden_key_str );
+    g_free ( extend_budget_key_str );
 
     return true;
 }
@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <gmodule.h>
+
+#if defined ( HAVE_AVX2 ) || defined ( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+#include "prefilter.h"
+
+/**
+ * Returns the class of a byte, from 0 to 63.
+ */
+static unsigned int get_byte_class ( unsigned char c );
+
+/**
+ * Matches the signatures one by one.
+ */
+static void match_scalar ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap );
+
+#ifdef __SSE2__
+/**
+ * Matches two signatures at once with SSE2 instructions.
+ */
+static void match_sse2 ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap );
+#endif
+
+#ifdef HAVE_AVX2
+/**
+ * Matches four signatures at once with AVX2 instructions, only called if the CPU supports them.
+ */
+__attribute__ ( ( target ( "avx2" ) ) )
+static void match_avx2 ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap );
+#endif
+
+// ================================================================================================================= //
+
+uint64_t prefilter_signature ( const char *text, size_t len )
+{
+    uint64_t signature = 0;
+    for ( size_t i = 0; i < len; i++ ) {
+        signature |= UINT64_C ( 1 ) << get_byte_class ( text[i] );
+    }
+    return signature;
+}
+
+void prefilter_match ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap )
+{
+    prefilter_match_with ( prefilter_get_method (), signatures, num, query, bitmap );
+}
+
+FBPrefilterMethod prefilter_get_method ( void )
+{
+#ifdef HAVE_AVX2
+    if ( __builtin_cpu_supports ( "avx2" ) ) {
+        return PREFILTER_AVX2;
+    }
+#endif
+#ifdef __SSE2__
+    return PREFILTER_SSE2;
+#else
+    return PREFILTER_SCALAR;
+#endif
+}
+
+void prefilter_match_with ( FBPrefilterMethod method, const uint64_t *signatures, unsigned int num, uint64_t query,
+        uint64_t *bitmap )
+{
+    switch ( method ) {
+#ifdef HAVE_AVX2
+        case PREFILTER_AVX2:
+            match_avx2 ( signatures, num, query, bitmap );
+            break;
+#endif
+#ifdef __SSE2__
+        case PREFILTER_SSE2:
+            match_sse2 ( signatures, num, query, bitmap );
+            break;
+#endif
+        default:
+            match_scalar ( signatures, num, query, bitmap );
+            break;
+    }
+}
+
+static unsigned int get_byte_class ( unsigned char c )
+{
+    if ( c >= 'a' && c <= 'z' ) {
+        return c - 'a';
+    } else if ( c >= 'A' && c <= 'Z' ) {
+        return c - 'A';
+    } else if ( c >= '0' && c <= '9' ) {
+        return 26 + c - '0';
+    } else if ( c >= 0x80 ) {
+        /* Bytes of non-ASCII characters are told apart by their low bits. */
+        return 36 + ( c & 0x0f );
+    } else {
+        return 52 + c % 12;
+    }
+}
+
+static void match_scalar ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap )
+{
+    for ( unsigned int i = 0; i < num; i++ ) {
+        if ( ( signatures[i] & query ) != query ) {
+            bitmap[i / 64] &= ~ ( UINT64_C ( 1 ) << ( i % 64 ) );
+        }
+    }
+}
+
+#ifdef __SSE2__
+static void match_sse2 ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap )
+{
+    __m128i q = _mm_set1_epi64x ( ( long long ) query );
+
+    /* A word of the bitmap is built from 64 signatures, the remaining signatures are matched one by one. */
+    unsigned int i = 0;
+    for ( ; i + 64 <= num; i += 64 ) {
+        uint64_t word = 0;
+        for ( unsigned int j = 0; j < 64; j += 2 ) {
+            __m128i s = _mm_loadu_si128 ( ( const __m128i * ) &signatures[i + j] );
+            __m128i eq = _mm_cmpeq_epi32 ( _mm_and_si128 ( s, q ), q );
+            /* SSE2 compares 32-bit halves, both halves of a signature have to be equal. */
+            eq = _mm_and_si128 ( eq, _mm_shuffle_epi32 ( eq, _MM_SHUFFLE ( 2, 3, 0, 1 ) ) );
+            word |= ( uint64_t ) _mm_movemask_pd ( _mm_castsi128_pd ( eq ) ) << j;
+        }
+        bitmap[i / 64] &= word;
+    }
+    match_scalar ( &signatures[i], num - i, query, &bitmap[i / 64] );
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__ ( ( target ( "avx2" ) ) )
+static void match_avx2 ( const uint64_t *signatures, unsigned int num, uint64_t query, uint64_t *bitmap )
+{
+    __m256i q = _mm256_set1_epi64x ( ( long long ) query );
+
+    unsigned int i = 0;
+    for ( ; i + 64 <= num; i += 64 ) {
+        uint64_t word = 0;
+        for ( unsigned int j = 0; j < 64; j += 4 ) {
+            __m256i s = _mm256_loadu_si256 ( ( const __m256i * ) &signatures[i + j] );
+            __m256i eq = _mm256_cmpeq_epi64 ( _mm256_and_si256 ( s, q ), q );
+            word |= ( uint64_t ) _mm256_movemask_pd ( _mm256_castsi256_pd ( eq ) ) << j;
+        }
+        bitmap[i / 64] &= word;
+    }
+    match_scalar ( &signatures[i], num - i, query, &bitmap[i / 64] );
+}
+#endif
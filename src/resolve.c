@@ -0,0 +1,445 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "resolve.h"
+
+/**
+ * Number of requests a pool thread stats at once. Smaller batches are stat'ed on the calling thread.
+ */
+#define POOL_CHUNK_SIZE 64
+
+/**
+ * Requests stat'ed by one pool thread.
+ */
+typedef struct FBResolveChunk {
+    FBResolveRequest *requests;
+    unsigned int num_requests;
+    /* Number of chunks of the batch that are not done yet, shared by all chunks of the batch. */
+    unsigned int *pending;
+    GMutex *mutex;
+    GCond *cond;
+} FBResolveChunk;
+
+/**
+ * Stats the requests one after another on the calling thread.
+ */
+static void stat_requests ( FBResolveRequest *requests, unsigned int num_requests );
+
+/**
+ * Stats the requests on the thread pool and waits until all of them are done.
+ */
+static void pool_resolve ( FBResolveRequest *requests, unsigned int num_requests );
+
+/**
+ * Function run by the pool threads.
+ */
+static void pool_func ( gpointer data, gpointer user_data );
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Number of submission queue entries of a ring, i.e. the number of statx requests submitted at once.
+ */
+#define RING_ENTRIES 256
+
+/**
+ * Maximum number of rings kept for later batches, beyond which rings are freed once they are not used anymore.
+ */
+#define MAX_IDLE_RINGS 64
+
+/**
+ * Outcome of resolving requests with a ring.
+ */
+typedef enum {
+    /* All requests were resolved. */
+    RING_DONE,
+    /* The ring failed for this batch, e.g. because the kernel was out of resources. */
+    RING_FAILED,
+    /* io_uring or its statx requests are not supported or not permitted. */
+    RING_UNSUPPORTED,
+} FBRingResult;
+
+/**
+ * An io_uring instance with its mapped submission and completion queues.
+ */
+typedef struct {
+    int fd;
+    unsigned int entries;
+    /* Requests are still in flight after a failure, so the ring can't be used again. */
+    bool broken;
+
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* Result buffers of the submitted requests. */
+    struct statx *results;
+} FBRing;
+
+/**
+ * Creates a new ring. Returns NULL if it can't be created, and sets unsupported if io_uring is not supported or not
+ * permitted.
+ */
+static FBRing *ring_new ( bool *unsupported );
+
+/**
+ * Unmaps and closes a ring.
+ */
+static void ring_free ( FBRing *ring );
+
+/**
+ * Takes an idle ring, or creates a new one if there is none. Returns NULL like ring_new.
+ */
+static FBRing *ring_acquire ( bool *unsupported );
+
+/**
+ * Returns a ring to the idle rings once the calling thread is done with it.
+ */
+static void ring_release ( FBRing *ring );
+
+/**
+ * Resolves the requests with batched statx requests. Waits for all submitted requests to complete, even after a
+ * failure, in which case the requests have to be resolved otherwise.
+ */
+static FBRingResult ring_resolve ( FBRing *ring, FBResolveRequest *requests, unsigned int num_requests );
+
+/**
+ * Rings are not thread-safe, so each ring is used by one thread at a time. Setting up a ring costs a syscall and
+ * three mappings, so rings are kept for the threads of later walks instead of being freed with their threads.
+ */
+static GSList *idle_rings = NULL;
+static unsigned int num_idle_rings = 0;
+static GMutex idle_rings_mutex;
+
+/**
+ * Set when io_uring turns out to be unavailable (e.g. disabled or too old a kernel), so setup isn't retried.
+ */
+static gint ring_unavailable = false;
+
+#endif
+
+// ================================================================================================================= //
+
+void resolve_types ( FBResolveRequest *requests, unsigned int num_requests )
+{
+    if ( num_requests == 0 ) {
+        return;
+    }
+
+#ifdef HAVE_IO_URING
+    if ( ! g_atomic_int_get ( &ring_unavailable ) ) {
+        /* Other failures only fall back to the thread pool for this batch. */
+        bool unsupported = false;
+        FBRing *ring = ring_acquire ( &unsupported );
+        if ( ring != NULL ) {
+            FBRingResult result = ring_resolve ( ring, requests, num_requests );
+            ring_release ( ring );
+            if ( result == RING_DONE ) {
+                return;
+            }
+            unsupported = result == RING_UNSUPPORTED;
+        }
+        if ( unsupported ) {
+            g_atomic_int_set ( &ring_unavailable, true );
+        }
+    }
+#endif
+
+    pool_resolve ( requests, num_requests );
+}
+
+static void stat_requests ( FBResolveRequest *requests, unsigned int num_requests )
+{
+    struct stat st;
+    for ( unsigned int i = 0; i < num_requests; i++ ) {
+        FBResolveRequest *r = &requests[i];
+        if ( fstatat ( r->dfd, r->path, &st, r->flags ) == 0 ) {
+            r->error = 0;
+            r->mode = st.st_mode & S_IFMT;
+        } else {
+            r->error = errno;
+        }
+    }
+}
+
+static void pool_resolve ( FBResolveRequest *requests, unsigned int num_requests )
+{
+    static GThreadPool *pool = NULL;
+
+    if ( num_requests <= POOL_CHUNK_SIZE ) {
+        stat_requests ( requests, num_requests );
+        return;
+    }
+
+    if ( g_once_init_enter ( &pool ) ) {
+        g_once_init_leave ( &pool, g_thread_pool_new ( pool_func, NULL, g_get_num_processors (), false, NULL ) );
+    }
+
+    GMutex mutex;
+    GCond cond;
+    g_mutex_init ( &mutex );
+    g_cond_init ( &cond );
+
+    /* The first chunk is stat'ed by the calling thread. */
+    unsigned int num_chunks = ( num_requests + POOL_CHUNK_SIZE - 1 ) / POOL_CHUNK_SIZE;
+    unsigned int pending = num_chunks - 1;
+    FBResolveChunk *chunks = g_malloc ( num_chunks * sizeof ( FBResolveChunk ) );
+
+    for ( unsigned int i = 0; i < num_chunks; i++ ) {
+        chunks[i].requests = &requests[i * POOL_CHUNK_SIZE];
+        chunks[i].num_requests = MIN ( POOL_CHUNK_SIZE, num_requests - i * POOL_CHUNK_SIZE );
+        chunks[i].pending = &pending;
+        chunks[i].mutex = &mutex;
+        chunks[i].cond = &cond;
+        if ( i > 0 ) {
+            g_thread_pool_push ( pool, &chunks[i], NULL );
+        }
+    }
+    stat_requests ( chunks[0].requests, chunks[0].num_requests );
+
+    g_mutex_lock ( &mutex );
+    while ( pending > 0 ) {
+        g_cond_wait ( &cond, &mutex );
+    }
+    g_mutex_unlock ( &mutex );
+
+    g_free ( chunks );
+    g_mutex_clear ( &mutex );
+    g_cond_clear ( &cond );
+}
+
+static void pool_func ( gpointer data, G_GNUC_UNUSED gpointer user_data )
+{
+    FBResolveChunk *chunk = data;
+    stat_requests ( chunk->requests, chunk->num_requests );
+
+    g_mutex_lock ( chunk->mutex );
+    if ( --*chunk->pending == 0 ) {
+        g_cond_signal ( chunk->cond );
+    }
+    g_mutex_unlock ( chunk->mutex );
+}
+
+// ================================================================================================================= //
+
+#ifdef HAVE_IO_URING
+
+static FBRing *ring_new ( bool *unsupported )
+{
+    struct io_uring_params params;
+    memset ( &params, 0, sizeof ( params ) );
+
+    /* Kernels without io_uring fail with ENOSYS, and EPERM means it is disabled or blocked by seccomp. */
+    int fd = syscall ( __NR_io_uring_setup, RING_ENTRIES, &params );
+    if ( fd < 0 ) {
+        *unsupported = errno == ENOSYS || errno == EPERM;
+        return NULL;
+    }
+
+    FBRing *ring = g_malloc0 ( sizeof ( FBRing ) );
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->sq_ptr = MAP_FAILED;
+    ring->cq_ptr = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof ( unsigned int );
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof ( struct io_uring_cqe );
+    ring->sqes_size = params.sq_entries * sizeof ( struct io_uring_sqe );
+
+    /* Newer kernels map both queues with a single mmap. */
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if ( single_mmap ) {
+        ring->sq_size = ring->cq_size = MAX ( ring->sq_size, ring->cq_size );
+    }
+
+    ring->sq_ptr = mmap ( NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                          IORING_OFF_SQ_RING );
+    if ( ring->sq_ptr == MAP_FAILED ) {
+        ring_free ( ring );
+        return NULL;
+    }
+    if ( single_mmap ) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap ( NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                              IORING_OFF_CQ_RING );
+        if ( ring->cq_ptr == MAP_FAILED ) {
+            ring_free ( ring );
+            return NULL;
+        }
+    }
+    ring->sqes = mmap ( NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_SQES );
+    if ( ring->sqes == MAP_FAILED ) {
+        ring_free ( ring );
+        return NULL;
+    }
+
+    ring->sq_head  = ( unsigned int * ) ( ( char * ) ring->sq_ptr + params.sq_off.head );
+    ring->sq_tail  = ( unsigned int * ) ( ( char * ) ring->sq_ptr + params.sq_off.tail );
+    ring->sq_mask  = ( unsigned int * ) ( ( char * ) ring->sq_ptr + params.sq_off.ring_mask );
+    ring->sq_array = ( unsigned int * ) ( ( char * ) ring->sq_ptr + params.sq_off.array );
+    ring->cq_head  = ( unsigned int * ) ( ( char * ) ring->cq_ptr + params.cq_off.head );
+    ring->cq_tail  = ( unsigned int * ) ( ( char * ) ring->cq_ptr + params.cq_off.tail );
+    ring->cq_mask  = ( unsigned int * ) ( ( char * ) ring->cq_ptr + params.cq_off.ring_mask );
+    ring->cqes     = ( struct io_uring_cqe * ) ( ( char * ) ring->cq_ptr + params.cq_off.cqes );
+
+    ring->results = g_malloc ( ring->entries * sizeof ( struct statx ) );
+
+    return ring;
+}
+
+static void ring_free ( FBRing *ring )
+{
+    if ( ring == NULL ) {
+        return;
+    }
+    if ( ring->sqes != MAP_FAILED ) {
+        munmap ( ring->sqes, ring->sqes_size );
+    }
+    if ( ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr ) {
+        munmap ( ring->cq_ptr, ring->cq_size );
+    }
+    if ( ring->sq_ptr != MAP_FAILED ) {
+        munmap ( ring->sq_ptr, ring->sq_size );
+    }
+    close ( ring->fd );
+    g_free ( ring->results );
+    g_free ( ring );
+}
+
+static FBRing *ring_acquire ( bool *unsupported )
+{
+    g_mutex_lock ( &idle_rings_mutex );
+    FBRing *ring = NULL;
+    if ( idle_rings != NULL ) {
+        ring = idle_rings->data;
+        idle_rings = g_slist_delete_link ( idle_rings, idle_rings );
+        num_idle_rings--;
+    }
+    g_mutex_unlock ( &idle_rings_mutex );
+
+    return ring != NULL ? ring : ring_new ( unsupported );
+}
+
+static void ring_release ( FBRing *ring )
+{
+    g_mutex_lock ( &idle_rings_mutex );
+    bool keep = ! ring->broken && num_idle_rings < MAX_IDLE_RINGS;
+    if ( keep ) {
+        idle_rings = g_slist_prepend ( idle_rings, ring );
+        num_idle_rings++;
+    }
+    g_mutex_unlock ( &idle_rings_mutex );
+
+    if ( ! keep ) {
+        ring_free ( ring );
+    }
+}
+
+static FBRingResult ring_resolve ( FBRing *ring, FBResolveRequest *requests, unsigned int num_requests )
+{
+    FBRingResult result = RING_DONE;
+    for ( unsigned int start = 0; start < num_requests && result == RING_DONE; start += ring->entries ) {
+        unsigned int count = MIN ( ring->entries, num_requests - start );
+
+        /* Fill the submission queue. Only this thread writes the tail, so it can be read without a barrier. */
+        unsigned int tail = *ring->sq_tail;
+        for ( unsigned int i = 0; i < count; i++ ) {
+            FBResolveRequest *r = &requests[start + i];
+            unsigned int index = tail & *ring->sq_mask;
+            struct io_uring_sqe *sqe = &ring->sqes[index];
+
+            memset ( sqe, 0, sizeof ( *sqe ) );
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = r->dfd;
+            sqe->addr = ( uintptr_t ) r->path;
+            /* Only the file type is needed. */
+            sqe->len = STATX_TYPE;
+            sqe->off = ( uintptr_t ) &ring->results[i];
+            sqe->statx_flags = r->flags;
+            sqe->user_data = i;
+
+            ring->sq_array[index] = index;
+            tail++;
+        }
+        __atomic_store_n ( ring->sq_tail, tail, __ATOMIC_RELEASE );
+
+        /* Submit the requests and wait for all of them to complete. After a failure, no more requests are submitted,
+         * but the submitted ones still write their results and read their paths, so they are waited for as well. */
+        unsigned int submitted = 0;
+        unsigned int completed = 0;
+        while ( completed < ( result == RING_DONE ? count : submitted ) ) {
+            unsigned int to_submit = result == RING_DONE ? count - submitted : 0;
+            unsigned int to_complete = ( result == RING_DONE ? count : submitted ) - completed;
+            int ret = syscall ( __NR_io_uring_enter, ring->fd, to_submit, to_complete, IORING_ENTER_GETEVENTS,
+                                NULL, 0 );
+            if ( ret < 0 ) {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                if ( result != RING_DONE ) {
+                    /* The requests in flight can't be waited for, so the ring is not used again. */
+                    ring->broken = true;
+                    break;
+                }
+                result = errno == ENOSYS || errno == EPERM ? RING_UNSUPPORTED : RING_FAILED;
+                continue;
+            }
+            submitted += ret;
+
+            unsigned int head = *ring->cq_head;
+            unsigned int cq_tail = __atomic_load_n ( ring->cq_tail, __ATOMIC_ACQUIRE );
+            while ( head != cq_tail ) {
+                struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+                FBResolveRequest *r = &requests[start + cqe->user_data];
+                /* Kernels without IORING_OP_STATX reject the opcode with EINVAL. */
+                if ( cqe->res == -EINVAL ) {
+                    result = RING_UNSUPPORTED;
+                } else if ( cqe->res < 0 ) {
+                    r->error = -cqe->res;
+                } else {
+                    r->error = 0;
+                    r->mode = ring->results[cqe->user_data].stx_mode & S_IFMT;
+                }
+                head++;
+                completed++;
+            }
+            __atomic_store_n ( ring->cq_head, head, __ATOMIC_RELEASE );
+        }
+
+        /* Drop the requests that were not submitted after a failure, so they aren't submitted with the next batch. */
+        if ( result != RING_DONE ) {
+            __atomic_store_n ( ring->sq_tail, __atomic_load_n ( ring->sq_head, __ATOMIC_ACQUIRE ), __ATOMIC_RELEASE );
+        }
+    }
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,663 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <gmodule.h>
+
+#include "types.h"
+#include "sort.h"
+
+/**
+ * Smaller arrays are sorted by comparing the files directly.
+ */
+#define RADIX_SORT_MIN_FILES 1024
+
+/**
+ * Smaller runs of files with equal keys are sorted by comparing the files directly.
+ */
+#define RADIX_SORT_MIN_TIES 32
+
+/**
+ * Minimum number of files sorted or merged by one thread.
+ */
+#define PARALLEL_SORT_MIN_FILES 65536
+
+/**
+ * A file with its sort key.
+ */
+typedef struct {
+    uint64_t key;
+    FBFile file;
+} FBSortItem;
+
+/**
+ * The files that are sorted and how, shared by all threads of a sort.
+ */
+typedef struct {
+    const FBFile *files;
+    const FileBrowserFileData *fd;
+    GCompareDataFunc compare;
+    bool by_depth;
+    bool by_type;
+    bool natural;
+} FBSortContext;
+
+/**
+ * Work done by one thread: computing collation keys, sorting the items a with the buffer b, or merging the sorted
+ * runs a and b into out.
+ */
+typedef struct {
+    const FBSortContext *ctx;
+    FBSortItem *a;
+    unsigned int num_a;
+    FBSortItem *b;
+    unsigned int num_b;
+    FBSortItem *out;
+    /* Index of the first file whose items are sorted or whose names are collated. */
+    unsigned int first;
+    /* Collation keys computed by the task. */
+    FBArena keys;
+    GThread *thread;
+} FBSortTask;
+
+/**
+ * Runs the tasks on separate threads, the first one on the calling thread, and waits until all of them are done.
+ */
+static void run_tasks ( FBSortTask *tasks, unsigned int num_tasks, GThreadFunc func );
+
+/**
+ * Computes the collation keys that are missing for the names of the files and their parent directories.
+ * The files' own names are collated on num_threads threads.
+ */
+static void collate_names ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd, unsigned int num_threads );
+
+/**
+ * Computes the collation keys that are missing for the names of a part of the files.
+ */
+static gpointer collate_task ( gpointer data );
+
+/**
+ * Computes the collation key of a name and allocates it from the arena.
+ */
+static void collate_name ( const FBName *name, FBArena *arena );
+
+/**
+ * Computes the keys of a part of the files and sorts their items.
+ */
+static gpointer sort_task ( gpointer data );
+
+/**
+ * Merges two sorted runs of items.
+ */
+static gpointer merge_task ( gpointer data );
+
+/**
+ * Returns how many items of the run a come before the first diag items of the merged runs a and b.
+ */
+static unsigned int merge_split ( const FBSortItem *a, unsigned int num_a, const FBSortItem *b, unsigned int num_b,
+        unsigned int diag, const FBSortContext *ctx );
+
+/**
+ * Returns the sort key of a file. Files with different keys are in the order of their keys.
+ * Sets name_bytes to the number of bytes of the name in the key.
+ */
+static uint64_t get_key ( const FBFile *file, const FBSortContext *ctx, unsigned int *name_bytes );
+
+/**
+ * Returns a key of the 8 bytes of a file's relative name from the given offset on.
+ */
+static uint64_t get_name_key ( const FBName *name, unsigned int offset );
+
+/**
+ * Writes len bytes of a file's relative name from the given offset on to buffer, which must be zeroed.
+ */
+static void write_name_bytes ( const FBName *name, unsigned int offset, unsigned char *buffer, unsigned int len );
+
+/**
+ * Sorts items by their keys with a least significant digit radix sort. buffer must have room for all items.
+ */
+static void radix_sort ( FBSortItem *items, FBSortItem *buffer, unsigned int num_items );
+
+/**
+ * Sorts runs of items with equal keys. The names of the files in a run are equal up to offset. Large runs are radix
+ * sorted by the next bytes of the names, small runs are sorted by comparing their files. Keeps the keys of the items.
+ */
+static void sort_ties ( FBSortItem *items, FBSortItem *buffer, unsigned int num_items, unsigned int offset,
+        const FBSortContext *ctx );
+
+/**
+ * Compares items by their keys, and by their files if the keys are equal.
+ */
+static gint compare_items ( gconstpointer a, gconstpointer b, gpointer data );
+
+/**
+ * Compares the names of two files like strcmp compares their relative names, given the depths of the files.
+ * Only the names below the files' closest common parent directory are compared.
+ */
+static gint compare_names ( const FBName *a, unsigned int depth_a, const FBName *b, unsigned int depth_b,
+        bool natural );
+
+/**
+ * Compares the basenames of two names of the same directory, or of directories with the same path. more_a and more_b
+ * are set if the relative names continue below the names.
+ */
+static gint compare_basenames ( const FBName *a, bool more_a, const FBName *b, bool more_b, bool natural );
+
+/**
+ * Returns the parent directory the given number of levels above a name.
+ */
+static const FBName *get_ancestor ( const FBName *name, unsigned int levels );
+
+/**
+ * Compares files alphabetically.
+ */
+static gint compare_files ( gconstpointer a, gconstpointer b, gpointer data );
+
+/**
+ * Compares files to sort by type (directories first, inaccessible files last).
+ * Then compares files alphabetically.
+ */
+static gint compare_files_type ( gconstpointer a, gconstpointer b, gpointer data );
+
+/**
+ * Compares files to sort by depth.
+ * Then compares files alphabetically.
+ */
+static gint compare_files_depth ( gconstpointer a, gconstpointer b, gpointer data );
+
+/**
+ * Compares files to sort by depth.
+ * Then compares files to sort by type (directories first, inaccessible files last).
+ * Then compares files alphabetically.
+ */
+static gint compare_files_depth_type ( gconstpointer a, gconstpointer b, gpointer data );
+
+// ================================================================================================================= //
+
+void sort_file_array ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd )
+{
+    unsigned int num_threads = fd->num_threads > 0 ? fd->num_threads : g_get_num_processors ();
+    if ( fd->sort_natural ) {
+        collate_names ( files, num_files, fd, num_threads );
+    }
+
+    GCompareDataFunc compare = get_compare_func ( fd );
+    if ( num_files < RADIX_SORT_MIN_FILES ) {
+        g_qsort_with_data ( files, num_files, sizeof ( FBFile ), compare, fd );
+        return;
+    }
+
+    FBSortContext ctx;
+    ctx.files = files;
+    ctx.fd = fd;
+    ctx.compare = compare;
+    ctx.by_depth = fd->sort_by_depth;
+    ctx.by_type = fd->sort_by_type;
+    ctx.natural = fd->sort_natural;
+
+    unsigned int num_parts = CLAMP ( num_files / PARALLEL_SORT_MIN_FILES, 1, num_threads );
+
+    FBSortItem *items = g_malloc ( num_files * sizeof ( FBSortItem ) );
+    FBSortItem *buffer = g_malloc ( num_files * sizeof ( FBSortItem ) );
+    FBSortTask *tasks = g_malloc ( MAX ( num_parts, num_threads + 1 ) * sizeof ( FBSortTask ) );
+    unsigned int *bounds = g_malloc ( ( num_parts + 1 ) * sizeof ( unsigned int ) );
+
+    /* Sort equal parts of the files on separate threads. */
+    for ( unsigned int i = 0; i <= num_parts; i++ ) {
+        bounds[i] = ( uint64_t ) num_files * i / num_parts;
+    }
+    for ( unsigned int i = 0; i < num_parts; i++ ) {
+        tasks[i].ctx = &ctx;
+        tasks[i].a = &items[bounds[i]];
+        tasks[i].num_a = bounds[i + 1] - bounds[i];
+        tasks[i].b = &buffer[bounds[i]];
+        tasks[i].first = bounds[i];
+    }
+    run_tasks ( tasks, num_parts, sort_task );
+
+    /* Merge pairs of sorted runs until one run is left. Every merge is split into segments of the merged run, so all
+     * threads keep merging when only a few runs are left. */
+    FBSortItem *src = items;
+    FBSortItem *dst = buffer;
+    unsigned int num_runs = num_parts;
+    while ( num_runs > 1 ) {
+        unsigned int num_tasks = 0;
+        for ( unsigned int r = 0; r < num_runs; r += 2 ) {
+            FBSortItem *a = &src[bounds[r]];
+            unsigned int num_a = bounds[r + 1] - bounds[r];
+            FBSortItem *b = r + 1 < num_runs ? &src[bounds[r + 1]] : NULL;
+            unsigned int num_b = r + 1 < num_runs ? bounds[r + 2] - bounds[r + 1] : 0;
+
+            /* A run without a partner is copied as it is. */
+            unsigned int num_merged = num_a + num_b;
+            unsigned int num_segments = b != NULL ? MAX ( num_threads / ( num_runs / 2 ), 1 ) : 1;
+            num_segments = CLAMP ( num_merged / PARALLEL_SORT_MIN_FILES, 1, num_segments );
+            unsigned int split_a = 0;
+            unsigned int split_diag = 0;
+            for ( unsigned int s = 1; s <= num_segments; s++ ) {
+                unsigned int diag = ( uint64_t ) num_merged * s / num_segments;
+                unsigned int next_a = merge_split ( a, num_a, b, num_b, diag, &ctx );
+                FBSortTask *task = &tasks[num_tasks++];
+                task->ctx = &ctx;
+                task->a = &a[split_a];
+                task->num_a = next_a - split_a;
+                task->b = b != NULL ? &b[split_diag - split_a] : NULL;
+                task->num_b = ( diag - next_a ) - ( split_diag - split_a );
+                task->out = &dst[bounds[r] + split_diag];
+                split_a = next_a;
+                split_diag = diag;
+            }
+        }
+        run_tasks ( tasks, num_tasks, merge_task );
+
+        for ( unsigned int r = 0; r < num_runs; r += 2 ) {
+            bounds[r / 2] = bounds[r];
+        }
+        num_runs = ( num_runs + 1 ) / 2;
+        bounds[num_runs] = num_files;
+
+        FBSortItem *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    for ( unsigned int i = 0; i < num_files; i++ ) {
+        files[i] = src[i].file;
+    }
+
+    g_free ( bounds );
+    g_free ( tasks );
+    g_free ( buffer );
+    g_free ( items );
+}
+
+GCompareDataFunc get_compare_func ( const FileBrowserFileData *fd )
+{
+    if ( fd->sort_by_type ) {
+        return fd->sort_by_depth ? compare_files_depth_type : compare_files_type;
+    } else {
+        return fd->sort_by_depth ? compare_files_depth : compare_files;
+    }
+}
+
+static void collate_names ( FBFile *files, unsigned int num_files, FileBrowserFileData *fd, unsigned int num_threads )
+{
+    /* Every file has its own name, so the parts' names can be collated at the same time. */
+    FBSortContext ctx;
+    ctx.files = files;
+    unsigned int num_parts = CLAMP ( num_files / PARALLEL_SORT_MIN_FILES, 1, num_threads );
+    FBSortTask *tasks = g_malloc ( num_parts * sizeof ( FBSortTask ) );
+    for ( unsigned int i = 0; i < num_parts; i++ ) {
+        tasks[i].ctx = &ctx;
+        tasks[i].first = ( uint64_t ) num_files * i / num_parts;
+        tasks[i].num_a = ( uint64_t ) num_files * ( i + 1 ) / num_parts - tasks[i].first;
+        arena_init ( &tasks[i].keys );
+    }
+    run_tasks ( tasks, num_parts, collate_task );
+    for ( unsigned int i = 0; i < num_parts; i++ ) {
+        arena_merge ( &fd->names, &tasks[i].keys );
+    }
+    g_free ( tasks );
+
+    /* Parent directories are shared, and their names are only listed as files if directories are listed. */
+    for ( unsigned int i = 0; i < num_files; i++ ) {
+        for ( const FBName *name = files[i].name; name != NULL; name = name->parent ) {
+            if ( name->collate_key == NULL ) {
+                collate_name ( name, &fd->names );
+            }
+        }
+    }
+}
+
+static gpointer collate_task ( gpointer data )
+{
+    FBSortTask *task = data;
+    const FBFile *files = task->ctx->files;
+
+    for ( unsigned int i = task->first; i < task->first + task->num_a; i++ ) {
+        if ( files[i].name != NULL && files[i].name->collate_key == NULL ) {
+            collate_name ( files[i].name, &task->keys );
+        }
+    }
+
+    return NULL;
+}
+
+static void collate_name ( const FBName *name, FBArena *arena )
+{
+    char *valid = g_utf8_validate ( name->basename, -1, NULL ) ? NULL : g_utf8_make_valid ( name->basename, -1 );
+    char *key = g_utf8_collate_key_for_filename ( valid != NULL ? valid : name->basename, -1 );
+
+    size_t len = strlen ( key );
+    char *collate_key = arena_alloc ( arena, len + 1 );
+    memcpy ( collate_key, key, len + 1 );
+    /* Names are shared by the sorted files, their keys are only set before they are compared. */
+    ( ( FBName * ) name )->collate_key = collate_key;
+
+    g_free ( key );
+    g_free ( valid );
+}
+
+static void run_tasks ( FBSortTask *tasks, unsigned int num_tasks, GThreadFunc func )
+{
+    for ( unsigned int i = 1; i < num_tasks; i++ ) {
+        tasks[i].thread = g_thread_new ( "file-browser-sort", func, &tasks[i] );
+    }
+    func ( &tasks[0] );
+    for ( unsigned int i = 1; i < num_tasks; i++ ) {
+        g_thread_join ( tasks[i].thread );
+    }
+}
+
+static gpointer sort_task ( gpointer data )
+{
+    FBSortTask *task = data;
+    const FBSortContext *ctx = task->ctx;
+
+    unsigned int name_bytes = 0;
+    for ( unsigned int i = 0; i < task->num_a; i++ ) {
+        task->a[i].file = ctx->files[task->first + i];
+        task->a[i].key = get_key ( &task->a[i].file, ctx, &name_bytes );
+    }
+    radix_sort ( task->a, task->b, task->num_a );
+    sort_ties ( task->a, task->b, task->num_a, name_bytes, ctx );
+
+    return NULL;
+}
+
+static gpointer merge_task ( gpointer data )
+{
+    FBSortTask *task = data;
+    const FBSortItem *a = task->a;
+    const FBSortItem *b = task->b;
+    unsigned int num_a = task->num_a;
+    unsigned int num_b = task->num_b;
+    FBSortItem *out = task->out;
+
+    while ( num_a > 0 && num_b > 0 ) {
+        if ( compare_items ( a, b, ( gpointer ) task->ctx ) <= 0 ) {
+            *out++ = *a++;
+            num_a--;
+        } else {
+            *out++ = *b++;
+            num_b--;
+        }
+    }
+    if ( num_a > 0 ) {
+        memcpy ( out, a, num_a * sizeof ( FBSortItem ) );
+    } else if ( num_b > 0 ) {
+        memcpy ( out, b, num_b * sizeof ( FBSortItem ) );
+    }
+
+    return NULL;
+}
+
+static unsigned int merge_split ( const FBSortItem *a, unsigned int num_a, const FBSortItem *b, unsigned int num_b,
+        unsigned int diag, const FBSortContext *ctx )
+{
+    /* Binary search for the split of the merged run, items of a come first if they are equal to items of b. */
+    unsigned int low = diag > num_b ? diag - num_b : 0;
+    unsigned int high = MIN ( diag, num_a );
+    while ( low < high ) {
+        unsigned int mid = low + ( high - low ) / 2;
+        if ( compare_items ( &a[mid], &b[diag - mid - 1], ( gpointer ) ctx ) <= 0 ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static uint64_t get_key ( const FBFile *file, const FBSortContext *ctx, unsigned int *name_bytes )
+{
+    /* The key's bytes from the most significant one: the depth, capped at 16 bits, the type, and then as many bytes
+     * of the name as fit. */
+    uint64_t key = 0;
+    unsigned int bits = 64;
+    if ( ctx->by_depth ) {
+        bits -= 16;
+        key |= ( uint64_t ) MIN ( file->depth, 0xffff ) << bits;
+    }
+    if ( ctx->by_type ) {
+        bits -= 8;
+        key |= ( uint64_t ) file->type << bits;
+    }
+
+    unsigned char bytes[8] = { 0 };
+    *name_bytes = bits / 8;
+    if ( ctx->natural ) {
+        /* Names are compared by the collation keys of their components. Only the first component's key is used, the
+         * keys of the following components can't be concatenated in an order preserving way. */
+        const FBName *first = file->name;
+        while ( first != NULL && first->parent != NULL ) {
+            first = first->parent;
+        }
+        if ( first != NULL ) {
+            strncpy ( ( char * ) bytes, first->collate_key, *name_bytes );
+        }
+    } else {
+        write_name_bytes ( file->name, 0, bytes, *name_bytes );
+    }
+    for ( unsigned int i = 0; i < *name_bytes; i++ ) {
+        key |= ( uint64_t ) bytes[i] << ( bits - 8 * ( i + 1 ) );
+    }
+    return key;
+}
+
+static uint64_t get_name_key ( const FBName *name, unsigned int offset )
+{
+    unsigned char bytes[8] = { 0 };
+    write_name_bytes ( name, offset, bytes, 8 );
+    uint64_t key = 0;
+    for ( unsigned int i = 0; i < 8; i++ ) {
+        key = ( key << 8 ) | bytes[i];
+    }
+    return key;
+}
+
+static void write_name_bytes ( const FBName *name, unsigned int offset, unsigned char *buffer, unsigned int len )
+{
+    unsigned int end = offset + len;
+    for ( ; name != NULL && name->len > offset; name = name->parent ) {
+        unsigned int start = name->parent != NULL ? name->parent->len + 1 : 0;
+        if ( start > offset && start <= end ) {
+            buffer[start - 1 - offset] = G_DIR_SEPARATOR;
+        }
+        for ( unsigned int i = MAX ( start, offset ); i < end && i < name->len; i++ ) {
+            buffer[i - offset] = name->basename[i - start];
+        }
+    }
+}
+
+static void radix_sort ( FBSortItem *items, FBSortItem *buffer, unsigned int num_items )
+{
+    unsigned int counts[8][256] = { { 0 } };
+    for ( unsigned int i = 0; i < num_items; i++ ) {
+        uint64_t key = items[i].key;
+        for ( unsigned int d = 0; d < 8; d++ ) {
+            counts[d][( key >> ( 8 * d ) ) & 0xff]++;
+        }
+    }
+
+    FBSortItem *src = items;
+    FBSortItem *dst = buffer;
+    for ( unsigned int d = 0; d < 8; d++ ) {
+        unsigned int *count = counts[d];
+        /* Digits that are equal for all items, e.g. the high bytes of the depth, are skipped. */
+        if ( count[( src[0].key >> ( 8 * d ) ) & 0xff] == num_items ) {
+            continue;
+        }
+
+        unsigned int offset = 0;
+        for ( unsigned int c = 0; c < 256; c++ ) {
+            unsigned int n = count[c];
+            count[c] = offset;
+            offset += n;
+        }
+        for ( unsigned int i = 0; i < num_items; i++ ) {
+            dst[count[( src[i].key >> ( 8 * d ) ) & 0xff]++] = src[i];
+        }
+
+        FBSortItem *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if ( src != items ) {
+        memcpy ( items, src, num_items * sizeof ( FBSortItem ) );
+    }
+}
+
+static void sort_ties ( FBSortItem *items, FBSortItem *buffer, unsigned int num_items, unsigned int offset,
+        const FBSortContext *ctx )
+{
+    unsigned int start = 0;
+    for ( unsigned int i = 1; i <= num_items; i++ ) {
+        if ( i < num_items && items[i].key == items[start].key ) {
+            continue;
+        }
+
+        FBSortItem *run = &items[start];
+        unsigned int num_run = i - start;
+        uint64_t key = run->key;
+        /* The names of a run whose key ends with a zero byte are equal. */
+        if ( num_run >= RADIX_SORT_MIN_TIES && ( key & 0xff ) != 0 && ! ctx->natural ) {
+            for ( unsigned int j = 0; j < num_run; j++ ) {
+                run[j].key = get_name_key ( run[j].file.name, offset );
+            }
+            radix_sort ( run, &buffer[start], num_run );
+            sort_ties ( run, &buffer[start], num_run, offset + 8, ctx );
+            for ( unsigned int j = 0; j < num_run; j++ ) {
+                run[j].key = key;
+            }
+        } else if ( num_run > 1 ) {
+            g_qsort_with_data ( run, num_run, sizeof ( FBSortItem ), compare_items, ( gpointer ) ctx );
+        }
+        start = i;
+    }
+}
+
+static gint compare_items ( gconstpointer a, gconstpointer b, gpointer data )
+{
+    const FBSortItem *ia = a;
+    const FBSortItem *ib = b;
+    const FBSortContext *ctx = data;
+    if ( ia->key != ib->key ) {
+        return ia->key < ib->key ? -1 : 1;
+    } else {
+        return ctx->compare ( &ia->file, &ib->file, ( gpointer ) ctx->fd );
+    }
+}
+
+static gint compare_names ( const FBName *a, unsigned int depth_a, const FBName *b, unsigned int depth_b,
+        bool natural )
+{
+    const FBName *name_a = a;
+    const FBName *name_b = b;
+    /* Number of levels the compared names are above the names of the files. */
+    unsigned int levels_a = 0;
+    unsigned int levels_b = 0;
+
+    /* Go up to the same depth, and then up to the children of the closest common parent directory. */
+    for ( ; depth_a > depth_b; depth_a-- ) {
+        a = a->parent;
+        levels_a++;
+    }
+    for ( ; depth_b > depth_a; depth_b-- ) {
+        b = b->parent;
+        levels_b++;
+    }
+    if ( a == b ) {
+        return ( levels_a > 0 ) - ( levels_b > 0 );
+    }
+    while ( a->parent != b->parent ) {
+        a = a->parent;
+        b = b->parent;
+        levels_a++;
+        levels_b++;
+    }
+
+    /* Different directories can have the same path, e.g. a watched directory that was deleted and created again.
+     * Their children are compared then. */
+    gint cmp = compare_basenames ( a, levels_a > 0, b, levels_b > 0, natural );
+    while ( cmp == 0 && levels_a > 0 && levels_b > 0 ) {
+        a = get_ancestor ( name_a, --levels_a );
+        b = get_ancestor ( name_b, --levels_b );
+        cmp = compare_basenames ( a, levels_a > 0, b, levels_b > 0, natural );
+    }
+    return cmp;
+}
+
+static gint compare_basenames ( const FBName *a, bool more_a, const FBName *b, bool more_b, bool natural )
+{
+    if ( natural ) {
+        int cmp = strcmp ( a->collate_key, b->collate_key );
+        if ( cmp != 0 ) {
+            return cmp;
+        }
+    }
+
+    const unsigned char *ca = ( const unsigned char * ) a->basename;
+    const unsigned char *cb = ( const unsigned char * ) b->basename;
+    while ( *ca != '\0' && *ca == *cb ) {
+        ca++;
+        cb++;
+    }
+    int end_a = *ca != '\0' ? *ca : ( more_a ? G_DIR_SEPARATOR : '\0' );
+    int end_b = *cb != '\0' ? *cb : ( more_b ? G_DIR_SEPARATOR : '\0' );
+    return end_a - end_b;
+}
+
+static const FBName *get_ancestor ( const FBName *name, unsigned int levels )
+{
+    for ( ; levels > 0; levels-- ) {
+        name = name->parent;
+    }
+    return name;
+}
+
+static gint compare_files ( gconstpointer a, gconstpointer b, gpointer data )
+{
+    const FBFile *fa = a;
+    const FBFile *fb = b;
+    const FileBrowserFileData *fd = data;
+    return compare_names ( fa->name, fa->depth, fb->name, fb->depth, fd->sort_natural );
+}
+
+static gint compare_files_type ( gconstpointer a, gconstpointer b, gpointer data )
+{
+    const FBFile *fa = a;
+    const FBFile *fb = b;
+    const FileBrowserFileData *fd = data;
+    if ( fa->type != fb->type ) {
+        return fa->type - fb->type;
+    } else {
+        return compare_names ( fa->name, fa->depth, fb->name, fb->depth, fd->sort_natural );
+    }
+}
+
+static gint compare_files_depth ( gconstpointer a, gconstpointer b, gpointer data )
+{
+    const FBFile *fa = a;
+    const FBFile *fb = b;
+    const FileBrowserFileData *fd = data;
+    if ( fa->depth != fb->depth ) {
+        return fa->depth - fb->depth;
+    } else {
+        return compare_names ( fa->name, fa->depth, fb->name, fb->depth, fd->sort_natural );
+    }
+}
+
+static gint compare_files_depth_type ( gconstpointer a, gconstpointer b, gpointer data )
+{
+    const FBFile *fa = a;
+    const FBFile *fb = b;
+    const FileBrowserFileData *fd = data;
+    if ( fa->depth != fb->depth ) {
+        return fa->depth - fb->depth;
+    } else if ( fa->type != fb->type ) {
+        return fa->type - fb->type;
+    } else {
+        return compare_names ( fa->name, fa->depth, fb->name, fb->depth, fd->sort_natural );
+    }
+}
@@ -0,0 +1,337 @@
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#include "types.h"
+#include "util.h"
+#include "files.h"
+#include "walker.h"
+#include "stream.h"
+#include "watch.h"
+#include "exclude.h"
+#include "resolve.h"
+
+/**
+ * Number of files whose types are determined at once.
+ */
+#define RESOLVE_BATCH_SIZE 4096
+
+typedef struct FBStream {
+    /* The file data the files are appended to. Only accessed from the main thread. */
+    FileBrowserFileData *fd;
+    /* Copy of the file data's options for the walker. Its strings and exclude matcher are owned by the stream, since
+     * an abandoned walker can outlive the file data. */
+    FileBrowserFileData options;
+    GThread *thread;
+    /* Names of the found files. Filled by the walker when it is done, and only accessed after it has returned. */
+    FBArena names;
+    /* Set to stop the walker. */
+    gint cancelled;
+    /* Copy of the file list whose types are determined instead of listing files, NULL for listings. Its names belong
+     * to the file list, and are moved to names if the stream is abandoned. */
+    FBFile *files;
+    unsigned int num_files;
+    /* The determined types of files, by index. */
+    uint8_t *types;
+
+    /* Protects the fields below. */
+    GMutex mutex;
+    /* Files found by the walker that have not been appended to the file list yet. */
+    GArray *pending;
+    /* Number of files whose types have been determined, and number of them that have been applied to the file list. */
+    unsigned int num_resolved;
+    unsigned int num_applied;
+    /* The walker is done. */
+    bool done;
+    /* The stream has been cancelled without waiting for the walker, which frees the stream when it returns. */
+    bool abandoned;
+    /* ID of the scheduled main loop source that appends the pending files, 0 if none is scheduled. */
+    guint flush_source;
+} FBStream;
+
+/**
+ * Creates a stream with a snapshot of the file data's options and makes it the file data's active stream.
+ */
+static FBStream *new_stream ( FileBrowserFileData *fd );
+
+/**
+ * Runs the walker of a stream.
+ */
+static gpointer stream_thread ( gpointer data );
+
+/**
+ * Determines the types of a stream's files in batches and schedules applying them after every batch.
+ */
+static gpointer resolve_thread ( gpointer data );
+
+/**
+ * Marks a stream's thread as done and schedules the final flush. Returns true if the stream has been abandoned and
+ * has to be freed by its thread.
+ */
+static bool finish_stream ( FBStream *stream );
+
+/**
+ * Receives chunks of files from the walker and schedules appending them to the file list.
+ */
+static void stream_chunk ( FBFile *files, unsigned int num_files, void *user_data );
+
+/**
+ * Schedules stream_flush on the main loop if it isn't already scheduled. The stream's mutex must be held.
+ */
+static void schedule_flush ( FBStream *stream );
+
+/**
+ * Appends the pending files or applies the determined types to the file list and reloads rofi.
+ * Finishes the stream when its thread is done.
+ */
+static gboolean stream_flush ( gpointer data );
+
+/**
+ * Frees a stream whose walker has returned, including the names of pending files.
+ */
+static void free_stream ( FBStream *stream );
+
+// ================================================================================================================= //
+
+void stream_files ( FileBrowserFileData *fd )
+{
+    FBStream *stream = new_stream ( fd );
+    stream->thread = g_thread_new ( "file-browser-stream", stream_thread, stream );
+}
+
+void stream_types ( FileBrowserFileData *fd )
+{
+    if ( fd->num_files == 0 ) {
+        cancel_stream ( fd );
+        return;
+    }
+
+    FBStream *stream = new_stream ( fd );
+    stream->files = g_malloc ( fd->num_files * sizeof ( FBFile ) );
+    memcpy ( stream->files, fd->files, fd->num_files * sizeof ( FBFile ) );
+    stream->num_files = fd->num_files;
+    stream->types = g_malloc ( fd->num_files * sizeof ( uint8_t ) );
+    stream->thread = g_thread_new ( "file-browser-types", resolve_thread, stream );
+}
+
+static FBStream *new_stream ( FileBrowserFileData *fd )
+{
+    cancel_stream ( fd );
+
+    FBStream *stream = g_malloc0 ( sizeof ( FBStream ) );
+    stream->fd = fd;
+    stream->options = *fd;
+    stream->options.current_dir = g_strdup ( fd->current_dir );
+    stream->options.cache_dir = g_strdup ( fd->cache_dir );
+    stream->options.exclude_globs = g_strdupv ( fd->exclude_globs );
+    stream->options.exclude_matcher = exclude_matcher_new ( ( const char * const * ) fd->exclude_globs );
+    stream->options.up_text = NULL;
+    stream->options.shown = NULL;
+    stream->options.lru = NULL;
+    stream->options.mount_depths = NULL;
+    stream->options.active_watch = NULL;
+    stream->options.files = NULL;
+    stream->options.num_files = 0;
+    stream->options.size_files = 0;
+    stream->options.active_stream = NULL;
+    stream->options.icons = NULL;
+    arena_init ( &stream->options.names );
+    arena_init ( &stream->names );
+    stream->pending = g_array_new ( false, false, sizeof ( FBFile ) );
+    g_mutex_init ( &stream->mutex );
+
+    fd->active_stream = stream;
+    return stream;
+}
+
+void cancel_stream ( FileBrowserFileData *fd )
+{
+    FBStream *stream = fd->active_stream;
+    if ( stream == NULL ) {
+        return;
+    }
+    fd->active_stream = NULL;
+
+    /* The walker stops at its next check, but a read on a slow file system can block it for a long time. Instead of
+     * waiting for it, it is left to free the stream when it returns. */
+    g_atomic_int_set ( &stream->cancelled, true );
+
+    /* Once the stream is marked as abandoned and the mutex is released, a walker that is not done yet can free it at
+     * any time, so the stream is only accessed before that. */
+    g_mutex_lock ( &stream->mutex );
+    GThread *thread = stream->thread;
+    bool done = stream->done;
+    if ( stream->flush_source != 0 ) {
+        g_source_remove ( stream->flush_source );
+        stream->flush_source = 0;
+    }
+
+    /* The thread may still read the names of the files whose types it determines. */
+    if ( stream->files != NULL && ! done ) {
+        arena_merge ( &stream->names, &fd->names );
+    }
+    stream->abandoned = true;
+    g_mutex_unlock ( &stream->mutex );
+
+    /* A walker that was already done does not see that the stream has been abandoned. */
+    if ( done ) {
+        g_thread_join ( thread );
+        free_stream ( stream );
+    } else {
+        g_thread_unref ( thread );
+    }
+}
+
+static gpointer stream_thread ( gpointer data )
+{
+    FBStream *stream = data;
+    FileBrowserFileData *options = &stream->options;
+
+    /* Only recursive listings profit from multiple threads. */
+    walk_files_chunked ( options, options->depth != 1 ? options->num_threads : 1, &stream->names, stream_chunk,
+            stream, &stream->cancelled );
+
+    if ( finish_stream ( stream ) ) {
+        free_stream ( stream );
+    }
+    return NULL;
+}
+
+static gpointer resolve_thread ( gpointer data )
+{
+    FBStream *stream = data;
+
+    unsigned int batch_size = MIN ( stream->num_files, RESOLVE_BATCH_SIZE );
+    FBResolveRequest *requests = g_malloc ( batch_size * sizeof ( FBResolveRequest ) );
+    char **paths = g_malloc ( batch_size * sizeof ( char * ) );
+
+    for ( unsigned int start = 0; start < stream->num_files; start += batch_size ) {
+        if ( g_atomic_int_get ( &stream->cancelled ) ) {
+            break;
+        }
+
+        unsigned int count = MIN ( batch_size, stream->num_files - start );
+        for ( unsigned int i = 0; i < count; i++ ) {
+            paths[i] = get_file_path ( &stream->options, &stream->files[start + i] );
+            requests[i].dfd = AT_FDCWD;
+            requests[i].path = paths[i];
+            requests[i].flags = 0;
+        }
+
+        resolve_types ( requests, count );
+
+        /* Files that can't be stat'ed keep their type. */
+        for ( unsigned int i = 0; i < count; i++ ) {
+            uint8_t type = stream->files[start + i].type;
+            if ( requests[i].error == 0 ) {
+                type = S_ISDIR ( requests[i].mode ) ? DIRECTORY : RFILE;
+            }
+            stream->types[start + i] = type;
+            g_free ( paths[i] );
+        }
+
+        g_mutex_lock ( &stream->mutex );
+        stream->num_resolved = start + count;
+        schedule_flush ( stream );
+        g_mutex_unlock ( &stream->mutex );
+    }
+
+    g_free ( paths );
+    g_free ( requests );
+
+    if ( finish_stream ( stream ) ) {
+        free_stream ( stream );
+    }
+    return NULL;
+}
+
+static bool finish_stream ( FBStream *stream )
+{
+    g_mutex_lock ( &stream->mutex );
+    stream->done = true;
+    bool abandoned = stream->abandoned;
+    schedule_flush ( stream );
+    g_mutex_unlock ( &stream->mutex );
+    return abandoned;
+}
+
+static void stream_chunk ( FBFile *files, unsigned int num_files, void *user_data )
+{
+    FBStream *stream = user_data;
+
+    g_mutex_lock ( &stream->mutex );
+    g_array_append_vals ( stream->pending, files, num_files );
+    schedule_flush ( stream );
+    g_mutex_unlock ( &stream->mutex );
+}
+
+static void schedule_flush ( FBStream *stream )
+{
+    if ( stream->flush_source == 0 && ! stream->abandoned ) {
+        stream->flush_source = g_idle_add ( stream_flush, stream );
+    }
+}
+
+static gboolean stream_flush ( gpointer data )
+{
+    FBStream *stream = data;
+    FileBrowserFileData *fd = stream->fd;
+
+    g_mutex_lock ( &stream->mutex );
+    insert_files ( ( FBFile * ) stream->pending->data, stream->pending->len, fd );
+    g_array_set_size ( stream->pending, 0 );
+    for ( ; stream->num_applied < stream->num_resolved; stream->num_applied++ ) {
+        fd->files[stream->num_applied].type = stream->types[stream->num_applied];
+    }
+    bool done = stream->done;
+    stream->flush_source = 0;
+    g_mutex_unlock ( &stream->mutex );
+
+    /* The order of files whose types were determined is kept. */
+    if ( done && stream->files != NULL ) {
+        fd->active_stream = NULL;
+        g_thread_join ( stream->thread );
+        free_stream ( stream );
+    } else if ( done ) {
+        fd->hidden_pruned = stream->options.hidden_pruned;
+        fd->truncated_depth = stream->options.truncated_depth;
+
+        /* The final order replaces the order the files were found in. */
+        if ( fd->keep_order ) {
+            fd->unsorted = true;
+        } else {
+            sort_files ( fd );
+        }
+        fd->active_stream = NULL;
+        g_thread_join ( stream->thread );
+        arena_merge ( &fd->names, &stream->names );
+        free_stream ( stream );
+
+        /* Hidden files were shown while they were listed, but some hidden directories were skipped. */
+        if ( fd->hidden_pruned && fd->show_hidden ) {
+            load_files ( fd );
+        } else {
+            watch_files ( fd );
+        }
+    }
+
+    rofi_view_reload ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void free_stream ( FBStream *stream )
+{
+    g_array_free ( stream->pending, true );
+    arena_clear ( &stream->names );
+    g_mutex_clear ( &stream->mutex );
+    g_free ( stream->files );
+    g_free ( stream->types );
+    g_free ( stream->options.current_dir );
+    g_free ( stream->options.cache_dir );
+    g_strfreev ( stream->options.exclude_globs );
+    exclude_matcher_free ( stream->options.exclude_matcher );
+    g_free ( stream );
+}
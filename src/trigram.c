@@ -0,0 +1,266 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <gmodule.h>
+
+#include "trigram.h"
+
+/**
+ * Maximum number of trigrams of a text that are looked up. Longer texts are narrowed by their rarest trigrams among
+ * the first ones.
+ */
+#define MAX_QUERY_TRIGRAMS 64
+
+/**
+ * Initial number of slots of the hash table, a power of two.
+ */
+#define INITIAL_NUM_SLOTS 1024
+
+/**
+ * The ids of the texts that contain a trigram.
+ */
+typedef struct {
+    uint32_t trigram;
+    /* Number of ids in the list. */
+    uint32_t count;
+    /* The smallest id that can be added next, the delta of the next id is relative to it. */
+    uint32_t next_id;
+    /* Deltas of the ids, 7 bits per byte with the high bit set on all but the last byte of a delta. */
+    uint8_t *data;
+    uint32_t len;
+    uint32_t size;
+} FBPosting;
+
+/**
+ * Reads the ids of a posting list in ascending order.
+ */
+typedef struct {
+    const uint8_t *data;
+    const uint8_t *end;
+    uint32_t next_id;
+} FBPostingReader;
+
+struct FBTrigramIndex {
+    FBPosting *postings;
+    unsigned int num_postings;
+    unsigned int size_postings;
+    /* Open addressing hash table of the postings by trigram, holding their index + 1, or 0 for free slots. */
+    uint32_t *slots;
+    unsigned int num_slots;
+};
+
+/**
+ * Returns the trigram starting at text.
+ */
+static uint32_t get_trigram ( const char *text );
+
+/**
+ * Returns the slot of a trigram in the hash table, which holds its posting or is free.
+ */
+static uint32_t *find_slot ( const FBTrigramIndex *index, uint32_t trigram );
+
+/**
+ * Returns the posting list of a trigram, or NULL if no text contains it.
+ */
+static const FBPosting *find_posting ( const FBTrigramIndex *index, uint32_t trigram );
+
+/**
+ * Returns the posting list of a trigram, adding an empty one if no text contains it yet.
+ */
+static FBPosting *get_posting ( FBTrigramIndex *index, uint32_t trigram );
+
+/**
+ * Reads the next id of a posting list. Returns false at the end of the list.
+ */
+static bool read_id ( FBPostingReader *reader, uint32_t *id );
+
+// ================================================================================================================= //
+
+FBTrigramIndex *trigram_index_new ( void )
+{
+    FBTrigramIndex *index = g_malloc0 ( sizeof ( FBTrigramIndex ) );
+    index->num_slots = INITIAL_NUM_SLOTS;
+    index->slots = g_malloc0 ( index->num_slots * sizeof ( uint32_t ) );
+    return index;
+}
+
+void trigram_index_add ( FBTrigramIndex *index, unsigned int id, const char *text, size_t len )
+{
+    for ( size_t i = 0; i + 3 <= len; i++ ) {
+        FBPosting *posting = get_posting ( index, get_trigram ( &text[i] ) );
+
+        /* Trigrams that occur multiple times in a text are only added once. */
+        if ( posting->next_id > id ) {
+            continue;
+        }
+
+        if ( posting->size < posting->len + 5 ) {
+            posting->size = MAX ( posting->size * 2, 8 );
+            posting->data = g_realloc ( posting->data, posting->size );
+        }
+        uint32_t delta = id - posting->next_id;
+        while ( delta >= 0x80 ) {
+            posting->data[posting->len++] = ( delta & 0x7f ) | 0x80;
+            delta >>= 7;
+        }
+        posting->data[posting->len++] = delta;
+        posting->next_id = id + 1;
+        posting->count++;
+    }
+}
+
+bool trigram_index_narrow ( const FBTrigramIndex *index, const char *text, unsigned int *ids, unsigned int *num_ids,
+        bool narrowed )
+{
+    size_t len = strlen ( text );
+    if ( len < 3 ) {
+        return false;
+    }
+
+    /* Posting lists of the trigrams, the shortest first, so the ids are narrowed down early. */
+    const FBPosting *postings[MAX_QUERY_TRIGRAMS];
+    unsigned int num_postings = 0;
+    for ( size_t i = 0; i + 3 <= len && num_postings < MAX_QUERY_TRIGRAMS; i++ ) {
+        const FBPosting *posting = find_posting ( index, get_trigram ( &text[i] ) );
+        if ( posting == NULL ) {
+            *num_ids = 0;
+            return true;
+        }
+
+        unsigned int j = num_postings;
+        bool duplicate = false;
+        for ( unsigned int k = 0; k < num_postings; k++ ) {
+            duplicate |= postings[k] == posting;
+        }
+        if ( duplicate ) {
+            continue;
+        }
+        while ( j > 0 && postings[j - 1]->count > posting->count ) {
+            postings[j] = postings[j - 1];
+            j--;
+        }
+        postings[j] = posting;
+        num_postings++;
+    }
+
+    unsigned int first = 0;
+    if ( ! narrowed ) {
+        FBPostingReader reader = { postings[0]->data, postings[0]->data + postings[0]->len, 0 };
+        *num_ids = 0;
+        while ( read_id ( &reader, &ids[*num_ids] ) ) {
+            ( *num_ids )++;
+        }
+        first = 1;
+    }
+
+    /* Ids are intersected with each posting list, until either of them ends. */
+    for ( unsigned int p = first; p < num_postings && *num_ids > 0; p++ ) {
+        FBPostingReader reader = { postings[p]->data, postings[p]->data + postings[p]->len, 0 };
+        unsigned int n = 0;
+        uint32_t id;
+        bool has_id = read_id ( &reader, &id );
+        for ( unsigned int i = 0; i < *num_ids && has_id; ) {
+            if ( id < ids[i] ) {
+                has_id = read_id ( &reader, &id );
+            } else if ( id > ids[i] ) {
+                i++;
+            } else {
+                ids[n++] = ids[i++];
+                has_id = read_id ( &reader, &id );
+            }
+        }
+        *num_ids = n;
+    }
+
+    return true;
+}
+
+void trigram_index_reset ( FBTrigramIndex *index )
+{
+    for ( unsigned int i = 0; i < index->num_postings; i++ ) {
+        g_free ( index->postings[i].data );
+    }
+    index->num_postings = 0;
+    memset ( index->slots, 0, index->num_slots * sizeof ( uint32_t ) );
+}
+
+void trigram_index_free ( FBTrigramIndex *index )
+{
+    if ( index == NULL ) {
+        return;
+    }
+    trigram_index_reset ( index );
+    g_free ( index->postings );
+    g_free ( index->slots );
+    g_free ( index );
+}
+
+static uint32_t get_trigram ( const char *text )
+{
+    const unsigned char *bytes = ( const unsigned char * ) text;
+    return ( ( uint32_t ) bytes[0] << 16 ) | ( ( uint32_t ) bytes[1] << 8 ) | bytes[2];
+}
+
+static uint32_t *find_slot ( const FBTrigramIndex *index, uint32_t trigram )
+{
+    uint32_t hash = trigram * 0x9e3779b1u;
+    hash ^= hash >> 15;
+    for ( uint32_t i = hash & ( index->num_slots - 1 ); ; i = ( i + 1 ) & ( index->num_slots - 1 ) ) {
+        uint32_t slot = index->slots[i];
+        if ( slot == 0 || index->postings[slot - 1].trigram == trigram ) {
+            return &index->slots[i];
+        }
+    }
+}
+
+static const FBPosting *find_posting ( const FBTrigramIndex *index, uint32_t trigram )
+{
+    uint32_t slot = *find_slot ( index, trigram );
+    return slot != 0 ? &index->postings[slot - 1] : NULL;
+}
+
+static FBPosting *get_posting ( FBTrigramIndex *index, uint32_t trigram )
+{
+    uint32_t *slot = find_slot ( index, trigram );
+    if ( *slot != 0 ) {
+        return &index->postings[*slot - 1];
+    }
+
+    if ( index->size_postings <= index->num_postings ) {
+        index->size_postings = MAX ( index->size_postings * 2, 64 );
+        index->postings = g_realloc ( index->postings, index->size_postings * sizeof ( FBPosting ) );
+    }
+    FBPosting *posting = &index->postings[index->num_postings++];
+    memset ( posting, 0, sizeof ( FBPosting ) );
+    posting->trigram = trigram;
+    *slot = index->num_postings;
+
+    /* The hash table is kept at most half full. */
+    if ( index->num_postings * 2 > index->num_slots ) {
+        g_free ( index->slots );
+        index->num_slots *= 2;
+        index->slots = g_malloc0 ( index->num_slots * sizeof ( uint32_t ) );
+        for ( unsigned int i = 0; i < index->num_postings; i++ ) {
+            *find_slot ( index, index->postings[i].trigram ) = i + 1;
+        }
+    }
+    return posting;
+}
+
+static bool read_id ( FBPostingReader *reader, uint32_t *id )
+{
+    if ( reader->data >= reader->end ) {
+        return false;
+    }
+    uint32_t delta = 0;
+    for ( int shift = 0; ; shift += 7 ) {
+        uint8_t byte = *reader->data++;
+        delta |= ( uint32_t ) ( byte & 0x7f ) << shift;
+        if ( byte < 0x80 ) {
+            break;
+        }
+    }
+    *id = reader->next_id + delta;
+    reader->next_id = *id + 1;
+    return true;
+}
@@ -1,10 +1,16 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <sys/resource.h>
 #include <gmodule.h>
 #include <gio/gio.h>
 
 #include "util.h"
 
+/**
+ * Maximum number of file descriptors kept open while listing files, also without a descriptor limit.
+ */
+#define MAX_FD_BUDGET 4096
+
 /**
  * Returns the canonical version of the given path.
  */
@@ -41,6 +47,16 @@ void print_err ( const char *format, ... )
     g_free ( new_format );
 }
 
+unsigned int get_fd_budget ( void )
+{
+    /* The other half of the limit is left to rofi. */
+    struct rlimit limit;
+    if ( getrlimit ( RLIMIT_NOFILE, &limit ) != 0 || limit.rlim_cur == RLIM_INFINITY ) {
+        return MAX_FD_BUDGET;
+    }
+    return MAX ( 1, MIN ( limit.rlim_cur / 2, MAX_FD_BUDGET ) );
+}
+
 unsigned int count_strv ( const char **array ) {
     if ( array == NULL ) {
         return 0;
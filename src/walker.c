@@ -0,0 +1,1203 @@
+#include <stdbool.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#ifdef HAVE_GETDENTS64
+#include <sys/syscall.h>
+#endif
+
+#include "types.h"
+#include "files.h"
+#include "names.h"
+#include "resolve.h"
+#include "cache.h"
+#include "ignore.h"
+#include "util.h"
+#include "walker.h"
+
+/**
+ * Maximum time an idle thread waits before it tries to steal a directory again.
+ */
+#define IDLE_WAIT_USEC 1000
+
+/**
+ * Number of files a thread collects before it passes them on in a chunked walk.
+ */
+#define WALK_CHUNK_SIZE 1024
+
+/**
+ * Maximum time a thread holds back found files in a chunked walk.
+ */
+#define WALK_CHUNK_USEC 20000
+
+/**
+ * Number of separately locked parts of the set of visited directories. Must be a power of 2.
+ */
+#define VISITED_SHARDS 64
+
+#ifdef HAVE_GETDENTS64
+/**
+ * Size of the buffer directory entries are read into. Large buffers need fewer getdents64 calls per directory.
+ */
+#define DIRENTS_SIZE ( 128 * 1024 )
+
+/**
+ * Directory entry as returned by getdents64.
+ */
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} FBDirent64;
+#endif
+
+/**
+ * Reads the entries of a directory, with getdents64 where available and readdir otherwise.
+ */
+typedef struct {
+    int fd;
+#ifdef HAVE_GETDENTS64
+    char *buffer;
+    long len;
+    long pos;
+#else
+    DIR *dir;
+#endif
+} FBDirReader;
+
+/**
+ * A directory that has yet to be read.
+ */
+typedef struct FBWalkDir {
+    /* Absolute path of the directory, without a trailing separator ("" for the root directory).
+     * Only used to open the directory if its parent directory is not open anymore. */
+    char *path;
+    /* Name of the directory relative to the current directory, NULL for the current directory. */
+    const FBName *name;
+    /* Depth of the directory relative to the current directory. */
+    int depth;
+    /* The directory or one of its parents is hidden. */
+    bool hidden;
+    /* The parent directory if it is kept open to open this directory relative to it, NULL otherwise. */
+    struct FBWalkDir *parent;
+    /* Reads the directory. Kept open after reading if shared is set, until all subdirectories are opened. */
+    FBDirReader reader;
+    bool shared;
+    /* References to the open reader: one of the thread reading the directory, and one of each queued subdirectory
+     * while the directory is shared. The reader is closed when they are gone. */
+    gint refs;
+    /* Device and inode of the directory if symbolic links are followed, used to read every directory only once. */
+    dev_t dev;
+    ino_t ino;
+    /* Ignore rules of the parent directory until the directory is read, of the directory itself afterwards. */
+    const FBIgnoreDir *ignore;
+} FBWalkDir;
+
+/**
+ * A file whose type has to be determined with a stat call.
+ */
+typedef struct {
+    /* Offset of the file's name in the thread's deferred_names buffer. */
+    size_t name;
+    /* Type of the directory entry, DT_LNK or DT_UNKNOWN. */
+    unsigned char d_type;
+} FBWalkDeferred;
+
+/**
+ * Double-ended queue of directories owned by one thread.
+ * The owner pushes and pops directories at the bottom, other threads steal directories from the top.
+ */
+typedef struct {
+    GMutex mutex;
+    FBWalkDir **dirs;
+    /* Index of the first queued directory. */
+    unsigned int top;
+    /* Index after the last queued directory. */
+    unsigned int bottom;
+    /* Size of the dirs array. */
+    unsigned int size;
+} FBWalkDeque;
+
+/**
+ * Part of the set of directories that were read with followed symbolic links, by device and inode.
+ * Open addressing with linear probing, so a directory reached again through a symbolic link is found in constant time
+ * no matter how deep it is.
+ */
+typedef struct {
+    GMutex mutex;
+    /* Slots of the hash table, NULL if empty. The size is a power of 2. */
+    FBWalkDir **dirs;
+    unsigned int size;
+    unsigned int num_dirs;
+} FBWalkVisited;
+
+/**
+ * State of a walk. Walks don't share any state, so walks of different file data can run at the same time, e.g. in
+ * background threads or for several instances of the mode.
+ */
+typedef struct FBWalker FBWalker;
+
+typedef struct {
+    FBWalker *walker;
+    /* Index of the thread. */
+    unsigned int index;
+    GThread *thread;
+    FBWalkDeque deque;
+    /* Directories read by this thread, freed when the walk is done. */
+    GPtrArray *done_dirs;
+    /* Buffer to construct file paths in. */
+    GString *path;
+#ifdef HAVE_GETDENTS64
+    /* Buffer to read directory entries into. */
+    char *dirents;
+#endif
+    /* Files of the current directory whose types are determined in one batch. */
+    GArray *deferred;
+    GString *deferred_names;
+    GArray *requests;
+    /* Names of the files found by this thread. */
+    FBArena names;
+    /* Files found by this thread. */
+    FBFile *files;
+    unsigned int num_files;
+    unsigned int size_files;
+    /* Files found since the thread last added them to the walk's count in a budgeted walk. */
+    unsigned int num_found;
+    /* Subdirectories found in a budgeted walk, read with the next level. */
+    GPtrArray *next_dirs;
+    /* Time the thread last passed on its files in a chunked walk. */
+    gint64 last_chunk_time;
+    /* Records the directories read by this thread for the cache. */
+    FBCacheRecorder recorder;
+} FBWalkThread;
+
+struct FBWalker {
+    FileBrowserFileData *fd;
+    FBWalkThread *threads;
+    unsigned int num_threads;
+    /* Receives the found files in chunks, NULL to merge them into the file list at the end. */
+    FBWalkChunkFunc chunk_func;
+    void *user_data;
+    /* Stops the walk when set, may be NULL. */
+    const gint *cancelled;
+    /* Listing cache, NULL if the cache is not used. */
+    FBCache *cache;
+    /* Rules of the ignore files, NULL if ignore files are not used. */
+    FBIgnore *ignore;
+    /* Number of directories kept open for their subdirectories, and the maximum number of them. */
+    gint num_shared;
+    unsigned int fd_budget;
+    /* Directories read so far if symbolic links are followed, split by the hash of their device and inode. */
+    FBWalkVisited visited[VISITED_SHARDS];
+    /* Number of hidden files found, and whether hidden directories were skipped because of the hidden budget. */
+    gint num_hidden;
+    gint hidden_pruned;
+    /* A budgeted walk reads the directories level by level, and stops reading them once the deadline has passed or
+     * entry_budget files have been found. 0 means no limit. */
+    bool by_level;
+    gint64 deadline;
+    unsigned int entry_budget;
+    gint num_found;
+    gint over_budget;
+    /* Length of the current directory's path, used to determine the display names. */
+    size_t root_len;
+    /* Number of directories that are queued or currently being read. */
+    gint pending;
+    /* Idle threads wait here for new directories. */
+    GMutex idle_mutex;
+    GCond idle_cond;
+    gint num_idle;
+};
+
+/**
+ * Reads the directories of a thread's deque and steals directories from other threads until all directories
+ * have been read.
+ */
+static gpointer walk_thread ( gpointer data );
+
+/**
+ * Returns the next directory to read for the thread, or NULL if all directories have been read.
+ */
+static FBWalkDir *next_dir ( FBWalkThread *t );
+
+/**
+ * Reads a directory, inserts its files and queues its subdirectories.
+ */
+static void walk_dir ( FBWalkThread *t, FBWalkDir *dir );
+
+/**
+ * Replays the cached record of a directory if the directory is unchanged. Returns false if the directory has to be
+ * read.
+ */
+static bool walk_cached_dir ( FBWalkThread *t, FBWalkDir *dir );
+
+/**
+ * Handles a subdirectory found in a directory: queues it if it is descended into, inserts it otherwise.
+ */
+static void walk_found_dir ( FBWalkThread *t, FBWalkDir *dir, int dfd, const char *name, bool descend );
+
+/**
+ * Defers a file whose type is not known from its directory entry (symbolic links and DT_UNKNOWN).
+ */
+static void walk_defer_file ( FBWalkThread *t, const char *name, unsigned char d_type );
+
+/**
+ * Determines the types of the deferred files of a directory in one batch and inserts them.
+ */
+static void walk_resolve_deferred ( FBWalkThread *t, FBWalkDir *dir, int dfd, bool descend );
+
+/**
+ * Returns true if a subdirectory is not descended into because it is hidden, and the hidden budget is used up or
+ * symbolic links are followed.
+ */
+static bool walk_prune_hidden ( FBWalkThread *t, FBWalkDir *dir, const char *name );
+
+/**
+ * Queues a subdirectory of a directory to be read. dfd is an open descriptor of the directory, or AT_FDCWD to stat the
+ * subdirectory by its absolute path.
+ */
+static void walk_queue_subdir ( FBWalkThread *t, FBWalkDir *dir, int dfd, const char *name );
+
+/**
+ * Returns the absolute path of a file in a directory, in a buffer of the thread that is valid until the next call.
+ */
+static const char *walk_child_path ( FBWalkThread *t, FBWalkDir *dir, const char *name );
+
+/**
+ * Returns the path to open or stat a directory by, relative to the descriptor stored in dfd: its name if its parent
+ * directory is open, its absolute path otherwise.
+ */
+static const char *walk_dir_at ( FBWalkDir *dir, int *dfd );
+
+/**
+ * Drops a reference to the open reader of a directory, and closes it with the last one. dir may be NULL.
+ */
+static void walk_release ( FBWalker *w, FBWalkDir *dir );
+
+/**
+ * Queues a directory on the thread's deque and wakes up an idle thread.
+ */
+static void queue_dir ( FBWalkThread *t, FBWalkDir *dir );
+
+/**
+ * Adds a directory to the set of visited directories by its device and inode. Returns false if a directory with the
+ * same device and inode was added before, which is the case for symlink cycles and directories reached through
+ * multiple symbolic links.
+ */
+static bool walk_visit ( FBWalker *w, FBWalkDir *dir );
+
+/**
+ * Hashes the device and inode of a directory.
+ */
+static uint64_t visited_hash ( const FBWalkDir *dir );
+
+/**
+ * Inserts a file into the thread's file list.
+ */
+static void walk_insert_file ( FBWalkThread *t, const FBName *name, FBFileType type, int depth );
+
+/**
+ * Inserts a file found while reading a directory into the thread's file list, and records it for the cache.
+ */
+static void walk_insert_child ( FBWalkThread *t, FBWalkDir *dir, const char *name, FBFileType type );
+
+/**
+ * Passes the files found by the thread on to the chunk function.
+ */
+static void walk_pass_chunk ( FBWalkThread *t );
+
+/**
+ * Returns true if the walk has been cancelled.
+ */
+static bool walk_cancelled ( FBWalker *w );
+
+/**
+ * Returns true if a budgeted walk has used up its time or entry budget. Once it has, it stays used up.
+ */
+static bool walk_over_budget ( FBWalker *w );
+
+/**
+ * Reads the queued directories with the given number of threads, the calling thread working as the first one.
+ */
+static void walk_run_threads ( FBWalker *w, unsigned int num_threads );
+
+/**
+ * Inserts the directories a budgeted walk did not read anymore, and returns the smallest depth of them, or 0 if there
+ * are none.
+ */
+static unsigned int walk_insert_unread ( FBWalker *w );
+
+/**
+ * Opens a directory for reading, relative to the directory descriptor dfd. Sets errno and returns false if the
+ * directory can't be opened.
+ */
+static bool dir_reader_open ( FBDirReader *reader, int dfd, const char *path, FBWalkThread *t );
+
+/**
+ * Reads the next entry of a directory. Returns false if there are no more entries.
+ * The name is only valid until the next call.
+ */
+static bool dir_reader_next ( FBDirReader *reader, const char **name, unsigned char *d_type );
+
+/**
+ * Closes a directory opened with dir_reader_open.
+ */
+static void dir_reader_close ( FBDirReader *reader );
+
+static void deque_push ( FBWalkDeque *deque, FBWalkDir *dir );
+static FBWalkDir *deque_pop ( FBWalkDeque *deque );
+static FBWalkDir *deque_steal ( FBWalkDeque *deque );
+
+// ================================================================================================================= //
+
+void walk_files ( FileBrowserFileData *fd, unsigned int num_threads )
+{
+    walk_files_chunked ( fd, num_threads, &fd->names, NULL, NULL, NULL );
+}
+
+void walk_files_chunked ( FileBrowserFileData *fd, unsigned int num_threads, FBArena *names,
+        FBWalkChunkFunc chunk_func, void *user_data, const gint *cancelled )
+{
+    FBWalker walker;
+    walker.fd = fd;
+    walker.chunk_func = chunk_func;
+    walker.user_data = user_data;
+    walker.cancelled = cancelled;
+    walker.num_hidden = 0;
+    walker.hidden_pruned = false;
+    /* Depth 1 listings are fast to read and would only fill the cache directory. Ignore files can change without
+     * changing their directory, so listings that use them are not cached. */
+    walker.cache = fd->use_cache && fd->depth != 1 && ! fd->use_ignore_files ? cache_open ( fd ) : NULL;
+    walker.ignore = fd->use_ignore_files ? ignore_new () : NULL;
+    walker.num_shared = 0;
+    walker.fd_budget = get_fd_budget ();
+    walker.num_threads = num_threads > 0 ? num_threads : g_get_num_processors ();
+    walker.threads = g_malloc0 ( walker.num_threads * sizeof ( FBWalkThread ) );
+    walker.by_level = fd->depth != 1 && ( fd->time_budget > 0 || fd->entry_budget > 0 );
+    walker.deadline = walker.by_level && fd->time_budget > 0
+        ? g_get_monotonic_time () + ( gint64 ) fd->time_budget * 1000 : 0;
+    walker.entry_budget = walker.by_level ? fd->entry_budget : 0;
+    walker.num_found = 0;
+    walker.over_budget = false;
+    for ( unsigned int i = 0; i < VISITED_SHARDS; i++ ) {
+        g_mutex_init ( &walker.visited[i].mutex );
+        walker.visited[i].dirs = NULL;
+        walker.visited[i].size = 0;
+        walker.visited[i].num_dirs = 0;
+    }
+    walker.pending = 0;
+    walker.num_idle = 0;
+    g_mutex_init ( &walker.idle_mutex );
+    g_cond_init ( &walker.idle_cond );
+
+    for ( unsigned int i = 0; i < walker.num_threads; i++ ) {
+        FBWalkThread *t = &walker.threads[i];
+        t->walker = &walker;
+        t->index = i;
+        g_mutex_init ( &t->deque.mutex );
+        t->done_dirs = g_ptr_array_new ();
+        t->next_dirs = g_ptr_array_new ();
+        t->path = g_string_new ( NULL );
+        t->deferred = g_array_new ( false, false, sizeof ( FBWalkDeferred ) );
+        t->deferred_names = g_string_new ( NULL );
+        t->requests = g_array_new ( false, false, sizeof ( FBResolveRequest ) );
+        arena_init ( &t->names );
+        if ( walker.cache != NULL ) {
+            cache_recorder_init ( &t->recorder, walker.cache );
+        }
+    }
+
+    /* Queue the current directory. */
+    FBWalkDir *root = g_malloc0 ( sizeof ( FBWalkDir ) );
+    root->path = g_strdup ( fd->current_dir );
+    size_t root_len = strlen ( root->path );
+    if ( root_len > 0 && root->path[root_len - 1] == G_DIR_SEPARATOR ) {
+        root->path[--root_len] = '\0';
+    }
+    walker.root_len = root_len;
+    if ( walker.ignore != NULL ) {
+        root->ignore = ignore_load_ancestors ( walker.ignore, fd->current_dir );
+    }
+    struct stat st;
+    if ( fd->follow_symlinks && stat ( fd->current_dir, &st ) == 0 ) {
+        root->dev = st.st_dev;
+        root->ino = st.st_ino;
+        walk_visit ( &walker, root );
+    }
+    queue_dir ( &walker.threads[0], root );
+    walk_run_threads ( &walker, walker.by_level ? 1 : walker.num_threads );
+
+    /* A budgeted walk reads the subdirectories found on one level with all threads at once, and only starts the next
+     * level if there is budget left, so the listing is complete up to some depth. */
+    while ( walker.by_level && ! walk_cancelled ( &walker ) && ! walk_over_budget ( &walker ) ) {
+        unsigned int num_dirs = 0;
+        for ( unsigned int i = 0; i < walker.num_threads; i++ ) {
+            FBWalkThread *t = &walker.threads[i];
+            for ( unsigned int j = 0; j < t->next_dirs->len; j++ ) {
+                queue_dir ( &walker.threads[num_dirs++ % walker.num_threads], g_ptr_array_index ( t->next_dirs, j ) );
+            }
+            g_ptr_array_set_size ( t->next_dirs, 0 );
+        }
+        if ( num_dirs == 0 ) {
+            break;
+        }
+        walk_run_threads ( &walker, MIN ( walker.num_threads, num_dirs ) );
+    }
+    fd->truncated_depth = walker.by_level && ! walk_cancelled ( &walker ) ? walk_insert_unread ( &walker ) : 0;
+
+    /* Merge the file lists of all threads. */
+    unsigned int num_files = fd->num_files;
+    for ( unsigned int i = 0; i < walker.num_threads; i++ ) {
+        num_files += walker.threads[i].num_files;
+    }
+    fd->hidden_pruned = g_atomic_int_get ( &walker.hidden_pruned );
+
+    /* A cancelled, pruned or truncated walk did not read all directories, and must not replace the cache. */
+    if ( walker.cache != NULL ) {
+        if ( ! walk_cancelled ( &walker ) && ! fd->hidden_pruned && fd->truncated_depth == 0 ) {
+            FBCacheRecorder *recorders = g_malloc ( walker.num_threads * sizeof ( FBCacheRecorder ) );
+            for ( unsigned int i = 0; i < walker.num_threads; i++ ) {
+                recorders[i] = walker.threads[i].recorder;
+            }
+            cache_save ( walker.cache, recorders, walker.num_threads );
+            g_free ( recorders );
+        }
+        for ( unsigned int i = 0; i < walker.num_threads; i++ ) {
+            cache_recorder_clear ( &walker.threads[i].recorder );
+        }
+        cache_close ( walker.cache );
+    }
+
+    if ( chunk_func == NULL && fd->size_files < num_files ) {
+        fd->size_files = num_files;
+        fd->files = g_realloc ( fd->files, fd->size_files * sizeof ( FBFile ) );
+    }
+    for ( unsigned int i = 0; i < walker.num_threads; i++ ) {
+        FBWalkThread *t = &walker.threads[i];
+        if ( chunk_func == NULL ) {
+            memcpy ( &fd->files[fd->num_files], t->files, t->num_files * sizeof ( FBFile ) );
+            fd->num_files += t->num_files;
+        }
+        arena_merge ( names, &t->names );
+
+        /* Directories left over by a cancelled walk. */
+        for ( unsigned int j = t->deque.top; j < t->deque.bottom; j++ ) {
+            g_ptr_array_add ( t->done_dirs, t->deque.dirs[j] );
+        }
+        for ( unsigned int j = 0; j < t->next_dirs->len; j++ ) {
+            g_ptr_array_add ( t->done_dirs, g_ptr_array_index ( t->next_dirs, j ) );
+        }
+        g_ptr_array_free ( t->next_dirs, true );
+
+        for ( unsigned int j = 0; j < t->done_dirs->len; j++ ) {
+            FBWalkDir *dir = g_ptr_array_index ( t->done_dirs, j );
+            /* Directories whose subdirectories were not read anymore are still open. */
+            if ( dir->refs > 0 ) {
+                dir_reader_close ( &dir->reader );
+            }
+            g_free ( dir->path );
+            g_free ( dir );
+        }
+        g_ptr_array_free ( t->done_dirs, true );
+        g_string_free ( t->path, true );
+        g_array_free ( t->deferred, true );
+        g_string_free ( t->deferred_names, true );
+        g_array_free ( t->requests, true );
+#ifdef HAVE_GETDENTS64
+        g_free ( t->dirents );
+#endif
+        g_free ( t->files );
+        g_free ( t->deque.dirs );
+        g_mutex_clear ( &t->deque.mutex );
+    }
+
+    if ( walker.ignore != NULL ) {
+        ignore_free ( walker.ignore );
+    }
+    for ( unsigned int i = 0; i < VISITED_SHARDS; i++ ) {
+        g_free ( walker.visited[i].dirs );
+        g_mutex_clear ( &walker.visited[i].mutex );
+    }
+    g_free ( walker.threads );
+    g_mutex_clear ( &walker.idle_mutex );
+    g_cond_clear ( &walker.idle_cond );
+}
+
+static void walk_run_threads ( FBWalker *w, unsigned int num_threads )
+{
+    for ( unsigned int i = 1; i < num_threads; i++ ) {
+        w->threads[i].thread = g_thread_new ( "file-browser-walker", walk_thread, &w->threads[i] );
+    }
+    walk_thread ( &w->threads[0] );
+    for ( unsigned int i = 1; i < num_threads; i++ ) {
+        g_thread_join ( w->threads[i].thread );
+        w->threads[i].thread = NULL;
+    }
+}
+
+static unsigned int walk_insert_unread ( FBWalker *w )
+{
+    unsigned int depth = 0;
+    for ( unsigned int i = 0; i < w->num_threads; i++ ) {
+        FBWalkThread *t = &w->threads[i];
+
+        /* Directories of the level that was being read, and subdirectories found on it. */
+        for ( unsigned int j = t->deque.top; j < t->deque.bottom; j++ ) {
+            g_ptr_array_add ( t->next_dirs, t->deque.dirs[j] );
+        }
+        t->deque.top = t->deque.bottom = 0;
+
+        for ( unsigned int j = 0; j < t->next_dirs->len; j++ ) {
+            FBWalkDir *dir = g_ptr_array_index ( t->next_dirs, j );
+            if ( ! w->fd->only_files ) {
+                walk_insert_file ( t, dir->name, DIRECTORY, dir->depth );
+            }
+            if ( depth == 0 || ( unsigned int ) dir->depth < depth ) {
+                depth = dir->depth;
+            }
+            g_ptr_array_add ( t->done_dirs, dir );
+        }
+        g_ptr_array_set_size ( t->next_dirs, 0 );
+
+        if ( w->chunk_func != NULL && t->num_files > 0 ) {
+            walk_pass_chunk ( t );
+        }
+    }
+    return depth;
+}
+
+static gpointer walk_thread ( gpointer data )
+{
+    FBWalkThread *t = data;
+    FBWalker *w = t->walker;
+
+    FBWalkDir *dir;
+    while ( ( dir = next_dir ( t ) ) != NULL ) {
+        walk_dir ( t, dir );
+        g_ptr_array_add ( t->done_dirs, dir );
+
+        if ( w->entry_budget > 0 ) {
+            g_atomic_int_add ( &w->num_found, t->num_found );
+            t->num_found = 0;
+        }
+
+        if ( w->chunk_func != NULL && t->num_files > 0
+                && g_get_monotonic_time () - t->last_chunk_time >= WALK_CHUNK_USEC ) {
+            walk_pass_chunk ( t );
+        }
+
+        /* Subdirectories are queued before the directory is done, so this only drops to 0 at the very end, or at the
+         * end of the level in a budgeted walk. */
+        if ( g_atomic_int_dec_and_test ( &w->pending ) ) {
+            g_mutex_lock ( &w->idle_mutex );
+            g_cond_broadcast ( &w->idle_cond );
+            g_mutex_unlock ( &w->idle_mutex );
+        }
+    }
+
+    if ( w->chunk_func != NULL && t->num_files > 0 ) {
+        walk_pass_chunk ( t );
+    }
+
+    return NULL;
+}
+
+static FBWalkDir *next_dir ( FBWalkThread *t )
+{
+    FBWalker *w = t->walker;
+
+    while ( true ) {
+        if ( walk_cancelled ( w ) || walk_over_budget ( w ) ) {
+            return NULL;
+        }
+
+        FBWalkDir *dir = deque_pop ( &t->deque );
+        if ( dir != NULL ) {
+            return dir;
+        }
+
+        /* Steal from the other threads, starting with the next one. */
+        for ( unsigned int i = 1; i < w->num_threads; i++ ) {
+            dir = deque_steal ( &w->threads[( t->index + i ) % w->num_threads].deque );
+            if ( dir != NULL ) {
+                return dir;
+            }
+        }
+
+        /* Wait for more directories, or stop if all directories have been read. */
+        g_mutex_lock ( &w->idle_mutex );
+        if ( g_atomic_int_get ( &w->pending ) == 0 ) {
+            g_mutex_unlock ( &w->idle_mutex );
+            return NULL;
+        }
+        g_atomic_int_inc ( &w->num_idle );
+        g_cond_wait_until ( &w->idle_cond, &w->idle_mutex, g_get_monotonic_time () + IDLE_WAIT_USEC );
+        g_atomic_int_add ( &w->num_idle, -1 );
+        g_mutex_unlock ( &w->idle_mutex );
+    }
+}
+
+static void queue_dir ( FBWalkThread *t, FBWalkDir *dir )
+{
+    FBWalker *w = t->walker;
+
+    g_atomic_int_inc ( &w->pending );
+    deque_push ( &t->deque, dir );
+
+    if ( g_atomic_int_get ( &w->num_idle ) > 0 ) {
+        g_mutex_lock ( &w->idle_mutex );
+        g_cond_signal ( &w->idle_cond );
+        g_mutex_unlock ( &w->idle_mutex );
+    }
+}
+
+static void walk_dir ( FBWalkThread *t, FBWalkDir *dir )
+{
+    FBWalker *w = t->walker;
+    FileBrowserFileData *fd = w->fd;
+
+    if ( w->cache != NULL && walk_cached_dir ( t, dir ) ) {
+        walk_release ( w, dir->parent );
+        return;
+    }
+
+    /* Directories are opened relative to their open parent directory, so the kernel does not resolve their whole path
+     * again. Directories are kept open for their subdirectories as long as the descriptor budget allows. */
+    int dfd;
+    const char *at_path = walk_dir_at ( dir, &dfd );
+    FBDirReader *reader = &dir->reader;
+    bool opened = dir_reader_open ( reader, dfd, at_path, t );
+    int err = errno;
+    walk_release ( w, dir->parent );
+    if ( opened ) {
+        dir->refs = 1;
+        dir->shared = ( unsigned int ) g_atomic_int_add ( &w->num_shared, 1 ) < w->fd_budget;
+        if ( ! dir->shared ) {
+            g_atomic_int_add ( &w->num_shared, -1 );
+        }
+    }
+
+    struct stat st;
+    bool stated = opened && w->cache != NULL && fstat ( reader->fd, &st ) == 0;
+
+    /* Directories are inserted when they are read, since only then it is known if they are accessible. */
+    if ( dir->depth > 0 ) {
+        if ( ! opened && err == EACCES ) {
+            walk_insert_file ( t, dir->name, INACCESSIBLE, dir->depth );
+        } else if ( ! fd->only_files ) {
+            walk_insert_file ( t, dir->name, DIRECTORY, dir->depth );
+        }
+    }
+
+    if ( ! opened ) {
+        return;
+    }
+
+    /* The rules of the directory's ignore files apply to its files and the directories below. */
+    if ( w->ignore != NULL ) {
+        dir->ignore = ignore_load_dir ( w->ignore, dir->ignore, reader->fd, dir->path );
+    }
+
+    /* The directory is stat'ed before it is read, so changes while reading it invalidate the record. */
+    if ( w->cache != NULL && stated ) {
+        cache_recorder_begin ( &t->recorder, &dir->path[w->root_len], &st );
+    }
+
+    int depth = dir->depth + 1;
+    bool descend = fd->depth == 0 || depth < fd->depth;
+
+    const char *name;
+    unsigned char d_type;
+    while ( dir_reader_next ( reader, &name, &d_type ) ) {
+        if ( walk_cancelled ( w ) ) {
+            break;
+        }
+
+        /* Skip "." and "..". Hidden files are listed and only hidden by the file list's view. */
+        if ( name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) ) {
+            continue;
+        /* Skip excluded patterns. */
+        } else if ( ! match_glob_patterns ( name, fd ) ) {
+            continue;
+        }
+
+        /* Ignored directories are pruned before they are opened. */
+        if ( w->ignore != NULL && d_type != DT_LNK && d_type != DT_UNKNOWN
+                && ignore_match ( dir->ignore, walk_child_path ( t, dir, name ), d_type == DT_DIR ) ) {
+            continue;
+        }
+
+        switch ( d_type ) {
+            case DT_DIR:
+                walk_found_dir ( t, dir, reader->fd, name, descend );
+                break;
+
+            /* Only symbolic links and file systems without d_type need to be stat'ed. */
+            case DT_LNK:
+            case DT_UNKNOWN:
+                walk_defer_file ( t, name, d_type );
+                break;
+
+            default:
+                if ( ! fd->only_dirs ) {
+                    walk_insert_child ( t, dir, name, RFILE );
+                }
+                break;
+        }
+    }
+
+    if ( t->deferred->len > 0 ) {
+        walk_resolve_deferred ( t, dir, reader->fd, descend );
+    }
+
+    if ( w->cache != NULL ) {
+        cache_recorder_end ( &t->recorder );
+    }
+
+    walk_release ( w, dir );
+}
+
+static bool walk_cached_dir ( FBWalkThread *t, FBWalkDir *dir )
+{
+    FBWalker *w = t->walker;
+    FileBrowserFileData *fd = w->fd;
+
+    int dfd;
+    const char *at_path = walk_dir_at ( dir, &dfd );
+    struct stat st;
+    if ( fstatat ( dfd, at_path, &st, 0 ) != 0 ) {
+        return false;
+    }
+    const FBCacheDir *cached = cache_lookup ( w->cache, &dir->path[w->root_len], &st );
+    if ( cached == NULL ) {
+        return false;
+    }
+
+    if ( dir->depth > 0 && ! fd->only_files ) {
+        walk_insert_file ( t, dir->name, DIRECTORY, dir->depth );
+    }
+    cache_recorder_copy ( &t->recorder, cached );
+
+    size_t pos = 0;
+    const char *name;
+    unsigned char type;
+    while ( cache_dir_next ( cached, &pos, &name, &type ) ) {
+        if ( type == CACHE_DESCEND && ! walk_prune_hidden ( t, dir, name ) ) {
+            walk_queue_subdir ( t, dir, AT_FDCWD, name );
+        } else if ( type == CACHE_DESCEND ) {
+            if ( ! fd->only_files ) {
+                walk_insert_file ( t, new_name ( &t->names, dir->name, name ), DIRECTORY, dir->depth + 1 );
+            }
+        } else {
+            walk_insert_file ( t, new_name ( &t->names, dir->name, name ), type, dir->depth + 1 );
+        }
+    }
+
+    return true;
+}
+
+static void walk_found_dir ( FBWalkThread *t, FBWalkDir *dir, int dfd, const char *name, bool descend )
+{
+    if ( descend && ! walk_prune_hidden ( t, dir, name ) ) {
+        walk_queue_subdir ( t, dir, dfd, name );
+        if ( t->walker->cache != NULL ) {
+            cache_recorder_add ( &t->recorder, name, CACHE_DESCEND );
+        }
+    } else if ( faccessat ( dfd, name, R_OK, 0 ) != 0 && errno == EACCES ) {
+        walk_insert_child ( t, dir, name, INACCESSIBLE );
+    } else if ( ! t->walker->fd->only_files ) {
+        walk_insert_child ( t, dir, name, DIRECTORY );
+    }
+}
+
+static bool walk_prune_hidden ( FBWalkThread *t, FBWalkDir *dir, const char *name )
+{
+    FBWalker *w = t->walker;
+    /* Directories reached through symbolic links are only read once, so hidden directories must not be read before
+     * the shown paths to them when following symlinks. */
+    if ( w->fd->show_hidden || ! ( dir->hidden || name[0] == '.' ) || ( ! w->fd->follow_symlinks
+            && ( unsigned int ) g_atomic_int_get ( &w->num_hidden ) < w->fd->hidden_budget ) ) {
+        return false;
+    }
+    g_atomic_int_set ( &w->hidden_pruned, true );
+    return true;
+}
+
+static void walk_queue_subdir ( FBWalkThread *t, FBWalkDir *dir, int dfd, const char *name )
+{
+    FileBrowserFileData *fd = t->walker->fd;
+
+    FBWalkDir *subdir = g_malloc0 ( sizeof ( FBWalkDir ) );
+    subdir->path = g_strconcat ( dir->path, G_DIR_SEPARATOR_S, name, NULL );
+    subdir->name = new_name ( &t->names, dir->name, name );
+    subdir->depth = dir->depth + 1;
+    subdir->hidden = dir->hidden || name[0] == '.';
+    subdir->ignore = dir->ignore;
+
+    /* With followed symlinks, directories are claimed when they are found, so a directory reached through multiple
+     * paths is only read through the path found first, and symlink cycles end there. Directories found again are
+     * listed without their contents. */
+    struct stat st;
+    if ( fd->follow_symlinks && fstatat ( dfd, dfd != AT_FDCWD ? name : subdir->path, &st, 0 ) == 0 ) {
+        subdir->dev = st.st_dev;
+        subdir->ino = st.st_ino;
+        if ( ! walk_visit ( t->walker, subdir ) ) {
+            if ( ! fd->only_files ) {
+                walk_insert_file ( t, subdir->name, DIRECTORY, subdir->depth );
+            }
+            g_free ( subdir->path );
+            g_free ( subdir );
+            return;
+        }
+    }
+
+    if ( dir->shared ) {
+        g_atomic_int_inc ( &dir->refs );
+        subdir->parent = dir;
+    }
+    if ( t->walker->by_level ) {
+        g_ptr_array_add ( t->next_dirs, subdir );
+    } else {
+        queue_dir ( t, subdir );
+    }
+}
+
+static void walk_defer_file ( FBWalkThread *t, const char *name, unsigned char d_type )
+{
+    FBWalkDeferred deferred;
+    deferred.name = t->deferred_names->len;
+    deferred.d_type = d_type;
+    g_string_append_len ( t->deferred_names, name, strlen ( name ) + 1 );
+    g_array_append_val ( t->deferred, deferred );
+}
+
+static void walk_resolve_deferred ( FBWalkThread *t, FBWalkDir *dir, int dfd, bool descend )
+{
+    FileBrowserFileData *fd = t->walker->fd;
+    GArray *deferred = t->deferred;
+    GArray *requests = t->requests;
+
+    /* Symbolic links found by lstat'ing unknown entries are resolved in a second pass. */
+    while ( deferred->len > 0 ) {
+        g_array_set_size ( requests, deferred->len );
+        for ( unsigned int i = 0; i < deferred->len; i++ ) {
+            FBWalkDeferred *d = &g_array_index ( deferred, FBWalkDeferred, i );
+            FBResolveRequest *r = &g_array_index ( requests, FBResolveRequest, i );
+            r->dfd = dfd;
+            r->path = &t->deferred_names->str[d->name];
+            r->flags = ( fd->follow_symlinks || d->d_type == DT_LNK ) ? 0 : AT_SYMLINK_NOFOLLOW;
+        }
+
+        resolve_types ( ( FBResolveRequest * ) requests->data, requests->len );
+
+        unsigned int num_unresolved = 0;
+        for ( unsigned int i = 0; i < deferred->len; i++ ) {
+            FBWalkDeferred *d = &g_array_index ( deferred, FBWalkDeferred, i );
+            FBResolveRequest *r = &g_array_index ( requests, FBResolveRequest, i );
+
+            /* Symbolic links count as directories for the ignore rules if they are listed as directories. Symbolic links
+             * found by lstat'ing unknown entries are checked when they are resolved. */
+            if ( t->walker->ignore != NULL && ! S_ISLNK ( r->mode ) && ignore_match ( dir->ignore,
+                    walk_child_path ( t, dir, r->path ), r->error == 0 && S_ISDIR ( r->mode ) ) ) {
+                continue;
+            }
+
+            if ( d->d_type == DT_LNK && ! fd->follow_symlinks ) {
+                /* Symbolic links are only reported when they are not followed. */
+                if ( r->error == 0 && S_ISDIR ( r->mode ) ) {
+                    if ( ! fd->only_files ) {
+                        walk_insert_child ( t, dir, r->path, DIRECTORY );
+                    }
+                } else if ( ! fd->only_dirs ) {
+                    walk_insert_child ( t, dir, r->path, RFILE );
+                }
+
+            } else if ( r->error == ENOENT && fd->follow_symlinks ) {
+                /* Symbolic link pointing to nonexistent file. */
+                walk_insert_child ( t, dir, r->path, INACCESSIBLE );
+
+            } else if ( r->error != 0 ) {
+                walk_insert_child ( t, dir, r->path, UNKNOWN );
+
+            } else if ( S_ISDIR ( r->mode ) ) {
+                walk_found_dir ( t, dir, dfd, r->path, descend );
+
+            } else if ( S_ISLNK ( r->mode ) ) {
+                d->d_type = DT_LNK;
+                g_array_index ( deferred, FBWalkDeferred, num_unresolved++ ) = *d;
+
+            } else if ( ! fd->only_dirs ) {
+                walk_insert_child ( t, dir, r->path, RFILE );
+            }
+        }
+        g_array_set_size ( deferred, num_unresolved );
+    }
+
+    g_string_truncate ( t->deferred_names, 0 );
+}
+
+static uint64_t visited_hash ( const FBWalkDir *dir )
+{
+    uint64_t hash = ( ( uint64_t ) dir->ino ^ ( ( uint64_t ) dir->dev << 32 | ( uint64_t ) dir->dev >> 32 ) )
+        * 0x9e3779b97f4a7c15;
+    return hash ^ hash >> 29;
+}
+
+static const char *walk_child_path ( FBWalkThread *t, FBWalkDir *dir, const char *name )
+{
+    g_string_truncate ( t->path, 0 );
+    g_string_append ( t->path, dir->path );
+    g_string_append_c ( t->path, G_DIR_SEPARATOR );
+    g_string_append ( t->path, name );
+    return t->path->str;
+}
+
+static const char *walk_dir_at ( FBWalkDir *dir, int *dfd )
+{
+    if ( dir->parent != NULL ) {
+        *dfd = dir->parent->reader.fd;
+        return dir->name->basename;
+    }
+    *dfd = AT_FDCWD;
+    return dir->path[0] != '\0' ? dir->path : G_DIR_SEPARATOR_S;
+}
+
+static void walk_release ( FBWalker *w, FBWalkDir *dir )
+{
+    if ( dir != NULL && g_atomic_int_dec_and_test ( &dir->refs ) ) {
+        dir_reader_close ( &dir->reader );
+        if ( dir->shared ) {
+            g_atomic_int_add ( &w->num_shared, -1 );
+        }
+    }
+}
+
+static bool walk_visit ( FBWalker *w, FBWalkDir *dir )
+{
+    /* The low bits of the hash select the shard, the others the slot. */
+    uint64_t hash = visited_hash ( dir );
+    FBWalkVisited *visited = &w->visited[hash & ( VISITED_SHARDS - 1 )];
+    hash /= VISITED_SHARDS;
+
+    g_mutex_lock ( &visited->mutex );
+
+    /* Keep the table at most half full. */
+    if ( ( visited->num_dirs + 1 ) * 2 > visited->size ) {
+        unsigned int size = visited->size > 0 ? visited->size * 2 : 64;
+        FBWalkDir **dirs = g_malloc0 ( size * sizeof ( FBWalkDir * ) );
+        for ( unsigned int i = 0; i < visited->size; i++ ) {
+            FBWalkDir *d = visited->dirs[i];
+            if ( d != NULL ) {
+                unsigned int j = ( visited_hash ( d ) / VISITED_SHARDS ) & ( size - 1 );
+                while ( dirs[j] != NULL ) {
+                    j = ( j + 1 ) & ( size - 1 );
+                }
+                dirs[j] = d;
+            }
+        }
+        g_free ( visited->dirs );
+        visited->dirs = dirs;
+        visited->size = size;
+    }
+
+    bool found = false;
+    unsigned int i = hash & ( visited->size - 1 );
+    for ( ; visited->dirs[i] != NULL; i = ( i + 1 ) & ( visited->size - 1 ) ) {
+        if ( visited->dirs[i]->dev == dir->dev && visited->dirs[i]->ino == dir->ino ) {
+            found = true;
+            break;
+        }
+    }
+    if ( ! found ) {
+        visited->dirs[i] = dir;
+        visited->num_dirs++;
+    }
+
+    g_mutex_unlock ( &visited->mutex );
+    return ! found;
+}
+
+static void walk_insert_file ( FBWalkThread *t, const FBName *name, FBFileType type, int depth )
+{
+    /* Increase the array size if needed. */
+    if ( t->size_files <= t->num_files ) {
+        t->size_files = t->size_files > 0 ? t->size_files * 2 : 64;
+        t->files = g_realloc ( t->files, t->size_files * sizeof ( FBFile ) );
+    }
+
+    FBFile *fbfile = &t->files[t->num_files];
+    fbfile->type = type;
+    fbfile->name = name;
+    fbfile->depth = depth;
+    fbfile->hidden = is_hidden_name ( name );
+    t->num_files++;
+    t->num_found++;
+
+    if ( fbfile->hidden ) {
+        g_atomic_int_inc ( &t->walker->num_hidden );
+    }
+
+    if ( t->walker->chunk_func != NULL && t->num_files >= WALK_CHUNK_SIZE ) {
+        walk_pass_chunk ( t );
+    }
+}
+
+static void walk_insert_child ( FBWalkThread *t, FBWalkDir *dir, const char *name, FBFileType type )
+{
+    walk_insert_file ( t, new_name ( &t->names, dir->name, name ), type, dir->depth + 1 );
+    if ( t->walker->cache != NULL ) {
+        cache_recorder_add ( &t->recorder, name, type );
+    }
+}
+
+static void walk_pass_chunk ( FBWalkThread *t )
+{
+    FBWalker *w = t->walker;
+    w->chunk_func ( t->files, t->num_files, w->user_data );
+    t->num_files = 0;
+    t->last_chunk_time = g_get_monotonic_time ();
+}
+
+static bool walk_cancelled ( FBWalker *w )
+{
+    return w->cancelled != NULL && g_atomic_int_get ( w->cancelled );
+}
+
+static bool walk_over_budget ( FBWalker *w )
+{
+    if ( g_atomic_int_get ( &w->over_budget ) ) {
+        return true;
+    } else if ( ( w->deadline > 0 && g_get_monotonic_time () >= w->deadline )
+            || ( w->entry_budget > 0 && ( unsigned int ) g_atomic_int_get ( &w->num_found ) >= w->entry_budget ) ) {
+        g_atomic_int_set ( &w->over_budget, true );
+        return true;
+    }
+    return false;
+}
+
+// ================================================================================================================= //
+
+static bool dir_reader_open ( FBDirReader *reader, int dfd, const char *path, FBWalkThread *t )
+{
+    reader->fd = openat ( dfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if ( reader->fd < 0 ) {
+        return false;
+    }
+
+#ifdef HAVE_GETDENTS64
+    if ( t->dirents == NULL ) {
+        t->dirents = g_malloc ( DIRENTS_SIZE );
+    }
+    reader->buffer = t->dirents;
+    reader->len = 0;
+    reader->pos = 0;
+#else
+    reader->dir = fdopendir ( reader->fd );
+    if ( reader->dir == NULL ) {
+        int err = errno;
+        close ( reader->fd );
+        errno = err;
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+static bool dir_reader_next ( FBDirReader *reader, const char **name, unsigned char *d_type )
+{
+#ifdef HAVE_GETDENTS64
+    if ( reader->pos >= reader->len ) {
+        reader->len = syscall ( SYS_getdents64, reader->fd, reader->buffer, DIRENTS_SIZE );
+        reader->pos = 0;
+        if ( reader->len <= 0 ) {
+            return false;
+        }
+    }
+    FBDirent64 *de = ( FBDirent64 * ) &reader->buffer[reader->pos];
+    reader->pos += de->d_reclen;
+    *name = de->d_name;
+    *d_type = de->d_type;
+    return true;
+#else
+    struct dirent *de = readdir ( reader->dir );
+    if ( de == NULL ) {
+        return false;
+    }
+    *name = de->d_name;
+#ifdef _DIRENT_HAVE_D_TYPE
+    *d_type = de->d_type;
+#else
+    *d_type = DT_UNKNOWN;
+#endif
+    return true;
+#endif
+}
+
+static void dir_reader_close ( FBDirReader *reader )
+{
+#ifdef HAVE_GETDENTS64
+    close ( reader->fd );
+#else
+    closedir ( reader->dir );
+#endif
+}
+
+// ================================================================================================================= //
+
+static void deque_push ( FBWalkDeque *deque, FBWalkDir *dir )
+{
+    g_mutex_lock ( &deque->mutex );
+    if ( deque->bottom >= deque->size ) {
+        /* Reuse the space of stolen directories before growing the array. */
+        if ( deque->top > 0 ) {
+            memmove ( deque->dirs, &deque->dirs[deque->top], ( deque->bottom - deque->top ) * sizeof ( FBWalkDir * ) );
+            deque->bottom -= deque->top;
+            deque->top = 0;
+        }
+        if ( deque->bottom >= deque->size ) {
+            deque->size = deque->size > 0 ? deque->size * 2 : 64;
+            deque->dirs = g_realloc ( deque->dirs, deque->size * sizeof ( FBWalkDir * ) );
+        }
+    }
+    deque->dirs[deque->bottom++] = dir;
+    g_mutex_unlock ( &deque->mutex );
+}
+
+static FBWalkDir *deque_pop ( FBWalkDeque *deque )
+{
+    FBWalkDir *dir = NULL;
+    g_mutex_lock ( &deque->mutex );
+    if ( deque->bottom > deque->top ) {
+        dir = deque->dirs[--deque->bottom];
+    }
+    if ( deque->bottom == deque->top ) {
+        deque->top = deque->bottom = 0;
+    }
+    g_mutex_unlock ( &deque->mutex );
+    return dir;
+}
+
+static FBWalkDir *deque_steal ( FBWalkDeque *deque )
+{
+    FBWalkDir *dir = NULL;
+    if ( ! g_mutex_trylock ( &deque->mutex ) ) {
+        return NULL;
+    }
+    if ( deque->bottom > deque->top ) {
+        dir = deque->dirs[deque->top++];
+    }
+    if ( deque->bottom == deque->top ) {
+        deque->top = deque->bottom = 0;
+    }
+    g_mutex_unlock ( &deque->mutex );
+    return dir;
+}
@@ -0,0 +1,580 @@
+#include <stdbool.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gmodule.h>
+
+#ifdef HAVE_INOTIFY
+#include <glib-unix.h>
+#include <sys/inotify.h>
+#endif
+
+#include "types.h"
+#include "util.h"
+#include "files.h"
+#include "names.h"
+#include "watch.h"
+#include "ignore.h"
+
+#ifdef HAVE_INOTIFY
+
+/**
+ * Events of watched directories that change the file list.
+ */
+#define WATCH_EVENTS ( IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR )
+
+typedef struct FBWatch {
+    FileBrowserFileData *fd;
+    /* The inotify instance and its main loop source. */
+    int inotify_fd;
+    guint source;
+    /* Names of the watched directories (NULL for the current directory), by watch descriptor.
+     * A directory reached through several paths has several names. */
+    GHashTable *dirs;
+    /* Relative names of the files that were created or deleted since the file list was last updated,
+     * with the names of their parent directories. */
+    GHashTable *changed;
+    /* The event queue overflowed, so changes were lost, or ignore files changed. The files are loaded again. */
+    bool reload;
+    /* Rules of the ignore files, NULL if ignore files are not used. */
+    FBIgnore *ignore;
+    /* Rules of the current directory, and of the other directories by name once they are needed. */
+    const FBIgnoreDir *ignore_root;
+    GHashTable *ignore_dirs;
+} FBWatch;
+
+/**
+ * A directory that is being scanned, used to detect symlink cycles in new directories.
+ */
+typedef struct FBWatchAncestor {
+    dev_t dev;
+    ino_t ino;
+    const struct FBWatchAncestor *parent;
+} FBWatchAncestor;
+
+/**
+ * Files found while applying a batch of changes.
+ */
+typedef struct {
+    /* Files to merge into the file list. */
+    GArray *files;
+    /* Names of the files that have been checked, so files of new directories are not added twice. */
+    GHashTable *names;
+} FBWatchScan;
+
+/**
+ * Adds a watch for a directory given by its name (NULL for the current directory), unless the watch limit has been
+ * reached. Returns false if symbolic links are followed and the directory is already watched through another path.
+ */
+static bool watch_dir ( FBWatch *w, const FBName *name );
+
+/**
+ * Reads the pending events of the inotify instance and applies them unless keep_order is set.
+ */
+static gboolean watch_read ( gint inotify_fd, GIOCondition condition, gpointer data );
+
+/**
+ * Records the file of an event as changed.
+ */
+static void watch_event ( FBWatch *w, const struct inotify_event *event );
+
+/**
+ * Removes the changed files from the file list and adds them again if they still exist.
+ * Loads the files again if changes were lost. Returns true if the file list was updated.
+ * The watch must not be used after applying changes, since loading the files again replaces it.
+ */
+static bool watch_apply ( FBWatch *w );
+
+/**
+ * Adds a file given by its parent directory's name and its basename to the scan if it exists and is not filtered.
+ * New directories whose files are listed are watched and scanned.
+ */
+static void watch_add_file ( FBWatch *w, FBWatchScan *scan, const FBName *parent, const char *basename,
+        const FBWatchAncestor *ancestors );
+
+/**
+ * Adds the files of a new directory to the scan.
+ */
+static void watch_scan_dir ( FBWatch *w, FBWatchScan *scan, const FBName *name, const char *path,
+        const FBWatchAncestor *ancestors );
+
+/**
+ * Returns the ignore rules of a directory given by its name (NULL for the current directory), loading them if needed.
+ */
+static const FBIgnoreDir *watch_get_ignore ( FBWatch *w, const FBName *name );
+
+/**
+ * Returns the relative name of a file in the given parent directory (NULL for the current directory).
+ * The name has to be freed.
+ */
+static char *build_name ( const FBName *parent, const char *basename );
+
+/**
+ * Returns true if the file name or one of its parent directories is in the set names.
+ */
+static bool is_below ( GHashTable *names, const char *name );
+
+/**
+ * Returns the depth of a file given by its name.
+ */
+static unsigned int get_name_depth ( const FBName *name );
+
+/**
+ * Compares directory names by depth, to watch shallow directories first.
+ */
+static gint compare_depth ( gconstpointer a, gconstpointer b );
+
+// ================================================================================================================= //
+
+void watch_files ( FileBrowserFileData *fd )
+{
+    cancel_watch ( fd );
+    /* Adding watches on network and FUSE mounts can block, and changes by other clients are not reported anyway. */
+    if ( ! fd->watch || fd->watch_limit == 0 || fd->slow_fs ) {
+        return;
+    }
+
+    int inotify_fd = inotify_init1 ( IN_NONBLOCK | IN_CLOEXEC );
+    if ( inotify_fd < 0 ) {
+        print_err ( "Could not watch directories for changes: %s\n", g_strerror ( errno ) );
+        return;
+    }
+
+    FBWatch *w = g_malloc0 ( sizeof ( FBWatch ) );
+    w->fd = fd;
+    w->inotify_fd = inotify_fd;
+    w->dirs = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL,
+            ( GDestroyNotify ) g_ptr_array_unref );
+    w->changed = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+    w->source = g_unix_fd_add ( inotify_fd, G_IO_IN, watch_read, w );
+    fd->active_watch = w;
+    if ( fd->use_ignore_files ) {
+        w->ignore = ignore_new ();
+        w->ignore_root = ignore_load_dir ( w->ignore, ignore_load_ancestors ( w->ignore, fd->current_dir ), -1,
+                fd->current_dir );
+        w->ignore_dirs = g_hash_table_new ( g_direct_hash, g_direct_equal );
+    }
+
+    watch_dir ( w, NULL );
+
+    /* Watch the directories whose files are listed: the parent directories of all files, and the directories that
+     * were descended into, but might be empty. Their contents are unknown if hidden directories were skipped, and
+     * below the depth the budget stopped the listing at. */
+    GHashTable *names = g_hash_table_new ( g_direct_hash, g_direct_equal );
+    GPtrArray *empty_dirs = g_ptr_array_new ();
+    for ( unsigned int i = 0; i < fd->num_files; i++ ) {
+        FBFile *file = &fd->files[i];
+        if ( file->type == UP ) {
+            continue;
+        } else if ( file->type == DIRECTORY && ( fd->depth == 0 || ( int ) file->depth < fd->depth )
+                && ( fd->truncated_depth == 0 || file->depth < fd->truncated_depth )
+                && ! ( file->hidden && fd->hidden_pruned ) ) {
+            g_ptr_array_add ( empty_dirs, ( gpointer ) file->name );
+        }
+        for ( const FBName *parent = file->name->parent; parent != NULL; parent = parent->parent ) {
+            if ( ! g_hash_table_add ( names, ( gpointer ) parent ) ) {
+                break;
+            }
+        }
+    }
+
+    /* Directories with files come first: with followed symlinks, a directory listed through several paths only has
+     * files below the path it was read through. The sort by depth keeps this order. */
+    GPtrArray *dirs = g_ptr_array_sized_new ( g_hash_table_size ( names ) + empty_dirs->len );
+    GHashTableIter iter;
+    gpointer name;
+    g_hash_table_iter_init ( &iter, names );
+    while ( g_hash_table_iter_next ( &iter, &name, NULL ) ) {
+        g_ptr_array_add ( dirs, name );
+    }
+    for ( unsigned int i = 0; i < empty_dirs->len; i++ ) {
+        if ( g_hash_table_add ( names, g_ptr_array_index ( empty_dirs, i ) ) ) {
+            g_ptr_array_add ( dirs, g_ptr_array_index ( empty_dirs, i ) );
+        }
+    }
+    g_ptr_array_free ( empty_dirs, true );
+    if ( dirs->len >= fd->watch_limit ) {
+        g_ptr_array_sort ( dirs, compare_depth );
+    }
+    for ( unsigned int i = 0; i < dirs->len; i++ ) {
+        watch_dir ( w, g_ptr_array_index ( dirs, i ) );
+    }
+    g_ptr_array_free ( dirs, true );
+    g_hash_table_destroy ( names );
+}
+
+void flush_watch ( FileBrowserFileData *fd )
+{
+    if ( fd->active_watch != NULL && watch_apply ( fd->active_watch ) ) {
+        rofi_view_reload ();
+    }
+}
+
+void cancel_watch ( FileBrowserFileData *fd )
+{
+    FBWatch *w = fd->active_watch;
+    if ( w == NULL ) {
+        return;
+    }
+    fd->active_watch = NULL;
+
+    g_source_remove ( w->source );
+    close ( w->inotify_fd );
+    g_hash_table_destroy ( w->dirs );
+    g_hash_table_destroy ( w->changed );
+    if ( w->ignore != NULL ) {
+        ignore_free ( w->ignore );
+        g_hash_table_destroy ( w->ignore_dirs );
+    }
+    g_free ( w );
+}
+
+static bool watch_dir ( FBWatch *w, const FBName *name )
+{
+    FileBrowserFileData *fd = w->fd;
+    if ( g_hash_table_size ( w->dirs ) >= fd->watch_limit ) {
+        return true;
+    }
+
+    /* Symbolic links to directories are only descended into when they are followed. */
+    uint32_t mask = fd->follow_symlinks ? WATCH_EVENTS : ( WATCH_EVENTS | IN_DONT_FOLLOW );
+    /* Ignore files are also read again when they are written to. */
+    if ( w->ignore != NULL ) {
+        mask |= IN_CLOSE_WRITE;
+    }
+    char *path;
+    if ( name != NULL ) {
+        char *rel_path = g_malloc ( name->len + 1 );
+        write_name ( name, rel_path );
+        path = g_build_filename ( fd->current_dir, rel_path, NULL );
+        g_free ( rel_path );
+    } else {
+        path = g_strdup ( fd->current_dir );
+    }
+    int wd = inotify_add_watch ( w->inotify_fd, path, mask );
+    g_free ( path );
+
+    if ( wd < 0 ) {
+        return true;
+    }
+
+    /* A directory reached through several paths has one watch descriptor. With followed symlinks, the listing only
+     * reads such a directory through the path it found first. */
+    GPtrArray *names = g_hash_table_lookup ( w->dirs, GINT_TO_POINTER ( wd ) );
+    if ( names == NULL ) {
+        names = g_ptr_array_new ();
+        g_hash_table_insert ( w->dirs, GINT_TO_POINTER ( wd ), names );
+    } else if ( fd->follow_symlinks ) {
+        return false;
+    }
+    g_ptr_array_add ( names, ( gpointer ) name );
+    return true;
+}
+
+static gboolean watch_read ( G_GNUC_UNUSED gint inotify_fd, G_GNUC_UNUSED GIOCondition condition, gpointer data )
+{
+    FBWatch *w = data;
+    char buffer[4096] __attribute__ ( ( aligned ( __alignof__ ( struct inotify_event ) ) ) );
+
+    ssize_t len;
+    while ( ( len = read ( w->inotify_fd, buffer, sizeof ( buffer ) ) ) > 0 ) {
+        const struct inotify_event *event;
+        for ( char *pos = buffer; pos < buffer + len; pos += sizeof ( struct inotify_event ) + event->len ) {
+            event = ( const struct inotify_event * ) pos;
+            watch_event ( w, event );
+        }
+    }
+
+    /* Files must not be reordered while keep_order is set, flush_watch applies the changes later. */
+    if ( ! w->fd->keep_order && watch_apply ( w ) ) {
+        rofi_view_reload ();
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void watch_event ( FBWatch *w, const struct inotify_event *event )
+{
+    if ( event->mask & IN_Q_OVERFLOW ) {
+        w->reload = true;
+        return;
+    } else if ( event->mask & IN_IGNORED ) {
+        g_hash_table_remove ( w->dirs, GINT_TO_POINTER ( event->wd ) );
+        return;
+    } else if ( event->len == 0 ) {
+        return;
+    }
+
+    GPtrArray *names = g_hash_table_lookup ( w->dirs, GINT_TO_POINTER ( event->wd ) );
+    if ( names == NULL ) {
+        return;
+    /* Changed ignore rules can change which files of any directory below are listed. */
+    } else if ( w->ignore != NULL && ignore_is_rules_file ( event->name ) ) {
+        w->reload = true;
+        return;
+    } else if ( ( event->mask & IN_CLOSE_WRITE ) || ! match_glob_patterns ( event->name, w->fd ) ) {
+        return;
+    }
+
+    for ( unsigned int i = 0; i < names->len; i++ ) {
+        const FBName *dir = g_ptr_array_index ( names, i );
+        g_hash_table_insert ( w->changed, build_name ( dir, event->name ), ( gpointer ) dir );
+    }
+}
+
+static bool watch_apply ( FBWatch *w )
+{
+    FileBrowserFileData *fd = w->fd;
+
+    if ( w->reload ) {
+        load_files ( fd );
+        return true;
+    } else if ( g_hash_table_size ( w->changed ) == 0 ) {
+        return false;
+    }
+
+    remove_files ( w->changed, fd );
+
+    /* Watches of removed directories are added again if the directories still exist. */
+    GHashTableIter iter;
+    gpointer wd;
+    gpointer value;
+    GString *dir_name = g_string_new ( NULL );
+    g_hash_table_iter_init ( &iter, w->dirs );
+    while ( g_hash_table_iter_next ( &iter, &wd, &value ) ) {
+        GPtrArray *names = value;
+        for ( unsigned int i = names->len; i > 0; i-- ) {
+            const FBName *dir = g_ptr_array_index ( names, i - 1 );
+            if ( dir == NULL ) {
+                continue;
+            }
+            g_string_set_size ( dir_name, dir->len );
+            write_name ( dir, dir_name->str );
+            if ( is_below ( w->changed, dir_name->str ) ) {
+                g_ptr_array_remove_index_fast ( names, i - 1 );
+            }
+        }
+        if ( names->len == 0 ) {
+            inotify_rm_watch ( w->inotify_fd, GPOINTER_TO_INT ( wd ) );
+            g_hash_table_iter_remove ( &iter );
+        }
+    }
+    g_string_free ( dir_name, true );
+
+    FBWatchScan scan;
+    scan.files = g_array_new ( false, false, sizeof ( FBFile ) );
+    scan.names = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+
+    g_hash_table_iter_init ( &iter, w->changed );
+    gpointer name;
+    while ( g_hash_table_iter_next ( &iter, &name, &value ) ) {
+        const FBName *parent = value;
+        watch_add_file ( w, &scan, parent, ( char * ) name + ( parent != NULL ? parent->len + 1 : 0 ), NULL );
+    }
+    g_hash_table_remove_all ( w->changed );
+
+    merge_files ( ( FBFile * ) scan.files->data, scan.files->len, fd );
+
+    g_array_free ( scan.files, true );
+    g_hash_table_destroy ( scan.names );
+    return true;
+}
+
+static void watch_add_file ( FBWatch *w, FBWatchScan *scan, const FBName *parent, const char *basename,
+        const FBWatchAncestor *ancestors )
+{
+    FileBrowserFileData *fd = w->fd;
+
+    char *name = build_name ( parent, basename );
+    if ( g_hash_table_contains ( scan->names, name ) ) {
+        g_free ( name );
+        return;
+    }
+    g_hash_table_add ( scan->names, name );
+
+    char *path = g_build_filename ( fd->current_dir, name, NULL );
+    unsigned int depth = parent != NULL ? get_name_depth ( parent ) + 1 : 1;
+    bool hidden = is_hidden_path ( name );
+    bool descend = false;
+    FBFileType type;
+
+    struct stat st;
+    FBWatchAncestor self;
+    if ( fstatat ( AT_FDCWD, path, &st, fd->follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW ) != 0 ) {
+        if ( errno != ENOENT ) {
+            type = UNKNOWN;
+        /* Symbolic link pointing to nonexistent file. */
+        } else if ( fd->follow_symlinks && lstat ( path, &st ) == 0 ) {
+            type = INACCESSIBLE;
+        /* The file was deleted. */
+        } else {
+            g_free ( path );
+            return;
+        }
+
+    } else if ( S_ISLNK ( st.st_mode ) ) {
+        /* Symbolic links are only reported when they are not followed. */
+        type = g_file_test ( path, G_FILE_TEST_IS_DIR ) ? DIRECTORY : RFILE;
+
+    } else if ( S_ISDIR ( st.st_mode ) ) {
+        type = DIRECTORY;
+        self.dev = st.st_dev;
+        self.ino = st.st_ino;
+        self.parent = ancestors;
+        descend = ( fd->depth == 0 || ( int ) depth < fd->depth )
+            && ( fd->truncated_depth == 0 || depth < fd->truncated_depth );
+        for ( const FBWatchAncestor *a = ancestors; a != NULL && descend; a = a->parent ) {
+            descend = a->dev != st.st_dev || a->ino != st.st_ino;
+        }
+        if ( access ( path, R_OK ) != 0 && errno == EACCES ) {
+            type = INACCESSIBLE;
+            descend = false;
+        /* New hidden directories are not descended into while hidden files are hidden. */
+        } else if ( descend && hidden && ! fd->show_hidden ) {
+            fd->hidden_pruned = true;
+            descend = false;
+        }
+
+    } else {
+        type = RFILE;
+    }
+
+    /* Ignored files are skipped and ignored directories are not scanned, the same way the listing skips them. */
+    bool is_dir = type == DIRECTORY || ( type == INACCESSIBLE && S_ISDIR ( st.st_mode ) );
+    if ( w->ignore != NULL && ignore_match ( watch_get_ignore ( w, parent ), path, is_dir ) ) {
+        g_free ( path );
+        return;
+    }
+
+    const FBName *file_name = new_name ( &fd->names, parent, basename );
+    if ( ( type == DIRECTORY && fd->only_files ) || ( type == RFILE && fd->only_dirs ) ) {
+        if ( descend ) {
+            watch_scan_dir ( w, scan, file_name, path, &self );
+        }
+        g_free ( path );
+        return;
+    }
+
+    FBFile fbfile;
+    fbfile.type = type;
+    fbfile.name = file_name;
+    fbfile.depth = depth;
+    fbfile.hidden = hidden;
+    g_array_append_val ( scan->files, fbfile );
+
+    if ( descend ) {
+        watch_scan_dir ( w, scan, file_name, path, &self );
+    }
+    g_free ( path );
+}
+
+static void watch_scan_dir ( FBWatch *w, FBWatchScan *scan, const FBName *name, const char *path,
+        const FBWatchAncestor *ancestors )
+{
+    /* The directory is watched before it is read, so no files created in between are missed. Directories that are
+     * already listed through another path are not listed again. */
+    if ( ! watch_dir ( w, name ) ) {
+        return;
+    }
+
+    DIR *dir = opendir ( path );
+    if ( dir == NULL ) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ( ( entry = readdir ( dir ) ) != NULL ) {
+        const char *basename = entry->d_name;
+        if ( basename[0] == '.' && ( basename[1] == '\0' || ( basename[1] == '.' && basename[2] == '\0' ) ) ) {
+            continue;
+        } else if ( ! match_glob_patterns ( basename, w->fd ) ) {
+            continue;
+        }
+
+        watch_add_file ( w, scan, name, basename, ancestors );
+    }
+
+    closedir ( dir );
+}
+
+static const FBIgnoreDir *watch_get_ignore ( FBWatch *w, const FBName *name )
+{
+    if ( name == NULL ) {
+        return w->ignore_root;
+    }
+
+    gpointer rules;
+    if ( g_hash_table_lookup_extended ( w->ignore_dirs, name, NULL, &rules ) ) {
+        return rules;
+    }
+
+    const FBIgnoreDir *parent = watch_get_ignore ( w, name->parent );
+    char *rel_path = g_malloc ( name->len + 1 );
+    write_name ( name, rel_path );
+    char *path = g_build_filename ( w->fd->current_dir, rel_path, NULL );
+    rules = ( gpointer ) ignore_load_dir ( w->ignore, parent, -1, path );
+    g_hash_table_insert ( w->ignore_dirs, ( gpointer ) name, rules );
+    g_free ( rel_path );
+    g_free ( path );
+    return rules;
+}
+
+static bool is_below ( GHashTable *names, const char *name )
+{
+    char *prefix = g_strdup ( name );
+    bool below = false;
+    char *sep;
+    while ( ! ( below = g_hash_table_contains ( names, prefix ) ) && ( sep = strrchr ( prefix, G_DIR_SEPARATOR ) ) ) {
+        *sep = '\0';
+    }
+    g_free ( prefix );
+    return below;
+}
+
+static char *build_name ( const FBName *parent, const char *basename )
+{
+    if ( parent == NULL ) {
+        return g_strdup ( basename );
+    }
+    size_t len = strlen ( basename );
+    char *name = g_malloc ( parent->len + len + 2 );
+    write_name ( parent, name );
+    name[parent->len] = G_DIR_SEPARATOR;
+    memcpy ( &name[parent->len + 1], basename, len + 1 );
+    return name;
+}
+
+static unsigned int get_name_depth ( const FBName *name )
+{
+    unsigned int depth = 0;
+    for ( ; name != NULL; name = name->parent ) {
+        depth++;
+    }
+    return depth;
+}
+
+static gint compare_depth ( gconstpointer a, gconstpointer b )
+{
+    const FBName *na = *( const FBName * const * ) a;
+    const FBName *nb = *( const FBName * const * ) b;
+    return ( int ) get_name_depth ( na ) - ( int ) get_name_depth ( nb );
+}
+
+#else
+
+void watch_files ( G_GNUC_UNUSED FileBrowserFileData *fd )
+{
+}
+
+void flush_watch ( G_GNUC_UNUSED FileBrowserFileData *fd )
+{
+}
+
+void cancel_watch ( G_GNUC_UNUSED FileBrowserFileData *fd )
+{
+}
+
+#endif
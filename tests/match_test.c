@@ -0,0 +1,208 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <gmodule.h>
+#include <rofi/helper.h>
+
+#include "types.h"
+#include "names.h"
+#include "match.h"
+
+/**
+ * Number of generated names, enough for the keys to be indexed.
+ */
+#define NUM_GENERATED_NAMES 6000
+
+/**
+ * Names with non-ASCII characters: accented, decomposed, and a Kelvin sign that matches "k" caselessly.
+ */
+static const char *non_ascii_names[] = {
+    "café", "cafe\xcc\x81", "naïve/résumé.txt", "\xe2\x84\xaa" "elvin", "Ærø", NULL
+};
+
+/**
+ * rofi's normalize-match option, which the helper_token_match below follows.
+ */
+static bool normalize_match = false;
+
+/**
+ * Number of keys that were matched differently than by helper_token_match.
+ */
+static int num_failures = 0;
+
+/**
+ * Builds the tokens of a query like rofi does: split at spaces, a leading '-' inverts a token, and each token is
+ * escaped (normal matching) or turned into "(a).*?(b)" (fuzzy matching).
+ */
+static rofi_int_matcher **tokenize ( const char *input, bool fuzzy, bool caseless );
+
+/**
+ * Frees tokens built by tokenize.
+ */
+static void free_tokens ( rofi_int_matcher **tokens );
+
+/**
+ * Returns the name with its combining characters removed after decomposing it, like rofi's normalize-match option.
+ */
+static char *simplify ( const char *name );
+
+/**
+ * Matches all keys to a query and compares the results to helper_token_match.
+ */
+static void check_query ( FBMatchKeys *keys, const char *input, bool fuzzy, bool caseless );
+
+/**
+ * Matches keys to queries that change without any notice, like in combi mode.
+ */
+static void check_queries ( FileBrowserFileData *fd );
+
+// ================================================================================================================= //
+
+char *rofi_force_utf8 ( const char *data, ssize_t length )
+{
+    return g_utf8_make_valid ( data, length );
+}
+
+int helper_token_match ( rofi_int_matcher * const *tokens, const char *input )
+{
+    char *simplified = normalize_match ? simplify ( input ) : NULL;
+    int match = true;
+    for ( int i = 0; match && tokens != NULL && tokens[i] != NULL; i++ ) {
+        match = g_regex_match ( tokens[i]->regex, simplified != NULL ? simplified : input, 0, NULL );
+        match ^= tokens[i]->invert;
+    }
+    g_free ( simplified );
+    return match;
+}
+
+int main ( void )
+{
+    FileBrowserFileData fd;
+    memset ( &fd, 0, sizeof ( FileBrowserFileData ) );
+    arena_init ( &fd.names );
+
+    static const char *parts[] = { "lib", "src", "usr", "share", "doc", "Makefile", "README", "a.out", "x", "zz" };
+    const FBName *dirs[10];
+    for ( int i = 0; i < 10; i++ ) {
+        dirs[i] = new_name ( &fd.names, NULL, parts[i] );
+    }
+    fd.files = g_malloc ( ( NUM_GENERATED_NAMES + G_N_ELEMENTS ( non_ascii_names ) ) * sizeof ( FBFile ) );
+    for ( int i = 0; i < NUM_GENERATED_NAMES; i++ ) {
+        char basename[32];
+        snprintf ( basename, sizeof ( basename ), "%s%d", parts[( i / 10 ) % 10], i );
+        fd.files[fd.num_files++] = ( FBFile ) { .name = new_name ( &fd.names, dirs[i % 10], basename ), .type = RFILE };
+    }
+    for ( int i = 0; non_ascii_names[i] != NULL; i++ ) {
+        const FBName *name = new_name ( &fd.names, NULL, non_ascii_names[i] );
+        fd.files[fd.num_files++] = ( FBFile ) { .name = name, .type = RFILE };
+    }
+
+    check_queries ( &fd );
+    normalize_match = true;
+    check_queries ( &fd );
+
+    g_free ( fd.files );
+    arena_clear ( &fd.names );
+
+    if ( num_failures > 0 ) {
+        fprintf ( stderr, "%d failures\n", num_failures );
+        return 1;
+    }
+    return 0;
+}
+
+static void check_queries ( FileBrowserFileData *fd )
+{
+    /* The keys find out whether names are normalized when they are created. The queries are narrowed down by the
+     * trigrams of all keys. */
+    FBMatchKeys *keys = match_keys_new ();
+    match_keys_update ( keys, fd, fd->num_files );
+    match_keys_wait_indexed ( keys );
+
+    for ( int fuzzy = 0; fuzzy < 2; fuzzy++ ) {
+        for ( int caseless = 0; caseless < 2; caseless++ ) {
+            /* More, fewer and other tokens of the same length follow each other. */
+            static const char *inputs[] = { "lib", "lib 1", "lib 1 -src", "lib", "usr", "usr", "sr", "share12",
+                "share12 -1234", "e", "cafe", "k", "a -lib", "ae", "" };
+            for ( int i = 0; i < ( int ) G_N_ELEMENTS ( inputs ); i++ ) {
+                check_query ( keys, inputs[i], fuzzy, caseless );
+            }
+        }
+    }
+
+    match_keys_free ( keys );
+}
+
+static void check_query ( FBMatchKeys *keys, const char *input, bool fuzzy, bool caseless )
+{
+    rofi_int_matcher **tokens = tokenize ( input, fuzzy, caseless );
+    for ( unsigned int i = 0; i < match_keys_count ( keys ); i++ ) {
+        const char *key = match_keys_get ( keys, i );
+        bool expected = helper_token_match ( tokens, key );
+        if ( match_keys_match ( keys, i, tokens ) != expected ) {
+            fprintf ( stderr, "\"%s\" (fuzzy %d, caseless %d, normalize %d) %s \"%s\"\n", input, fuzzy, caseless,
+                    normalize_match, expected ? "doesn't match" : "matches", key );
+            num_failures++;
+        }
+    }
+    free_tokens ( tokens );
+}
+
+static rofi_int_matcher **tokenize ( const char *input, bool fuzzy, bool caseless )
+{
+    char **words = g_strsplit ( input, " ", -1 );
+    rofi_int_matcher **tokens = g_malloc0 ( ( g_strv_length ( words ) + 1 ) * sizeof ( rofi_int_matcher * ) );
+    unsigned int num_tokens = 0;
+    for ( char **word = words; *word != NULL; word++ ) {
+        if ( **word == '\0' ) {
+            continue;
+        }
+        rofi_int_matcher *token = g_malloc0 ( sizeof ( rofi_int_matcher ) );
+        const char *text = *word;
+        if ( *text == '-' && text[1] != '\0' ) {
+            token->invert = true;
+            text++;
+        }
+
+        char *escaped = g_regex_escape_string ( text, -1 );
+        GString *pattern = g_string_new ( fuzzy ? "" : escaped );
+        for ( const char *c = escaped; fuzzy && *c != '\0'; c = g_utf8_next_char ( c ) ) {
+            g_string_append ( pattern, pattern->len == 0 ? "(" : ".*?(" );
+            if ( *c == '\\' ) {
+                g_string_append_c ( pattern, *c++ );
+            }
+            g_string_append_len ( pattern, c, g_utf8_next_char ( c ) - c );
+            g_string_append_c ( pattern, ')' );
+        }
+        GRegexCompileFlags flags = G_REGEX_OPTIMIZE | ( caseless ? G_REGEX_CASELESS : 0 );
+        token->regex = g_regex_new ( pattern->str, flags, 0, NULL );
+        g_string_free ( pattern, true );
+        g_free ( escaped );
+        tokens[num_tokens++] = token;
+    }
+    g_strfreev ( words );
+    return tokens;
+}
+
+static void free_tokens ( rofi_int_matcher **tokens )
+{
+    for ( rofi_int_matcher **token = tokens; *token != NULL; token++ ) {
+        g_regex_unref ( ( *token )->regex );
+        g_free ( *token );
+    }
+    g_free ( tokens );
+}
+
+static char *simplify ( const char *name )
+{
+    char *decomposed = g_utf8_normalize ( name, -1, G_NORMALIZE_ALL );
+    GString *simplified = g_string_new ( NULL );
+    for ( const char *c = decomposed; *c != '\0'; c = g_utf8_next_char ( c ) ) {
+        gunichar character = g_utf8_get_char ( c );
+        if ( ! g_unichar_ismark ( character ) ) {
+            g_string_append_unichar ( simplified, character );
+        }
+    }
+    g_free ( decomposed );
+    return g_string_free ( simplified, false );
+}
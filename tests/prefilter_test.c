@@ -0,0 +1,108 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <gmodule.h>
+
+#include "prefilter.h"
+
+/**
+ * Number of times each instruction set is tested with each number of signatures.
+ */
+#define NUM_ROUNDS 100
+
+/**
+ * Largest number of signatures that is tested.
+ */
+#define MAX_SIGNATURES 130
+
+/**
+ * Number of words of the bitmaps, with a word after the bits of the most signatures that must stay untouched.
+ */
+#define NUM_WORDS ( MAX_SIGNATURES / 64 + 2 )
+
+/**
+ * Numbers of signatures that are tested: none, fewer than, as many as and more than a word of the bitmap has bits, and
+ * two words with a tail.
+ */
+static const unsigned int sizes[] = { 0, 63, 64, 65, MAX_SIGNATURES };
+
+/**
+ * Number of bitmaps that differed from the bitmap of the scalar code.
+ */
+static int num_failures = 0;
+
+/**
+ * Matches random signatures with an instruction set and compares the bitmap to the bitmap of the scalar code, which is
+ * compared to the bits the signatures should keep.
+ */
+static void check_method ( FBPrefilterMethod method, unsigned int num, GRand *rand );
+
+/**
+ * Returns a random 64-bit number.
+ */
+static uint64_t random_bits ( GRand *rand );
+
+// ================================================================================================================= //
+
+int main ( void )
+{
+    GRand *rand = g_rand_new_with_seed ( 1 );
+
+    /* Every instruction set the CPU supports, not only the fastest one prefilter_match uses. */
+    for ( int method = PREFILTER_SCALAR; method <= ( int ) prefilter_get_method (); method++ ) {
+        for ( unsigned int i = 0; i < G_N_ELEMENTS ( sizes ); i++ ) {
+            for ( int round = 0; round < NUM_ROUNDS; round++ ) {
+                check_method ( method, sizes[i], rand );
+            }
+        }
+    }
+
+    g_rand_free ( rand );
+
+    if ( num_failures > 0 ) {
+        fprintf ( stderr, "%d failures\n", num_failures );
+        return 1;
+    }
+    return 0;
+}
+
+static void check_method ( FBPrefilterMethod method, unsigned int num, GRand *rand )
+{
+    /* Sparse queries, which about half of the signatures contain, with bits in both 32-bit halves. */
+    uint64_t query = random_bits ( rand ) & random_bits ( rand ) & random_bits ( rand );
+    uint64_t signatures[MAX_SIGNATURES];
+    for ( unsigned int i = 0; i < num; i++ ) {
+        signatures[i] = random_bits ( rand ) | ( g_rand_boolean ( rand ) ? query : 0 );
+    }
+
+    uint64_t bitmap[NUM_WORDS];
+    for ( int i = 0; i < NUM_WORDS; i++ ) {
+        bitmap[i] = random_bits ( rand );
+    }
+    uint64_t expected[NUM_WORDS];
+    memcpy ( expected, bitmap, sizeof ( bitmap ) );
+    uint64_t kept[NUM_WORDS];
+    memcpy ( kept, bitmap, sizeof ( bitmap ) );
+
+    prefilter_match_with ( PREFILTER_SCALAR, signatures, num, query, expected );
+    prefilter_match_with ( method, signatures, num, query, bitmap );
+
+    for ( unsigned int i = 0; i < num; i++ ) {
+        if ( ( signatures[i] & query ) != query ) {
+            kept[i / 64] &= ~ ( UINT64_C ( 1 ) << ( i % 64 ) );
+        }
+    }
+    if ( memcmp ( expected, kept, sizeof ( kept ) ) != 0 ) {
+        fprintf ( stderr, "scalar code with %u signatures keeps the wrong bits\n", num );
+        num_failures++;
+    }
+    if ( memcmp ( bitmap, expected, sizeof ( bitmap ) ) != 0 ) {
+        fprintf ( stderr, "instruction set %d with %u signatures differs from the scalar code\n", method, num );
+        num_failures++;
+    }
+}
+
+static uint64_t random_bits ( GRand *rand )
+{
+    return ( uint64_t ) g_rand_int ( rand ) << 32 | g_rand_int ( rand );
+}